@@ -0,0 +1,767 @@
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include "bench.h"
+#include "poke327.h"
+#include "character.h"
+#include "pathfind.h"
+#include "heap.h"
+
+/**************************************************************************
+ * poke327 --bench.  Generates a set of maps and times every pathfinding *
+ * engine on the same PC positions, checking that they all agree with    *
+ * the first engine.  Then, for every heap.c backend, replays the same   *
+ * seed through map generation, heap-driven pathfinding and game turns,  *
+ * races the turn scheduler against heap.c as a turn queue with growing  *
+ * numbers of NPCs, walks the PC around comparing incremental, cached    *
+ * and speculated distance maps with recomputing, and counts the         *
+ * distance maps that demand-driven pathfinding computes in part or      *
+ * never has to.                                                         *
+ * Then it crowds maps with pursuers, moving them by next-hop table and  *
+ * by looking around, and races multi-source distance maps against one   *
+ * map per source.  Last, it races A* routes, with and without           *
+ * landmarks, against whole distance maps.                               *
+ * No terminal needed, so it's scriptable.                               *
+ **************************************************************************/
+
+#define BENCH_MAPS      40
+#define BENCH_POSITIONS 25 /* PC positions per map */
+#define BENCH_REPEATS   20 /* Runs per position per engine */
+#define BENCH_HEAP_MAPS 20
+#define BENCH_TURNS     10000
+#define BENCH_SCHED_OPS 2000000 /* Pop and reschedule pairs per queue */
+#define BENCH_WALK_MAPS  10
+#define BENCH_WALK_STEPS 500     /* PC steps per map */
+#define BENCH_DEMAND_RADIUS 200  /* For the radius-bounded runs */
+#define BENCH_QUERIES    8       /* Routes per PC position and NPC type */
+#define BENCH_CROWD      300     /* Extra pursuers for bench_crowd() */
+#define BENCH_SOURCES    8       /* Most sources for bench_multi() */
+
+static double bench_now()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void bench_place_pc()
+{
+  do {
+    rand_pos(world.pc.pos);
+  } while (move_cost[char_pc][world.cur_map->map[world.pc.pos[dim_y]]
+                                                [world.pc.pos[dim_x]]] ==
+           INT_MAX);
+}
+
+/* Walk out the east gate, the way the player would, so that the new *
+ * map places the PC somewhere sensible.                              */
+static void bench_next_map()
+{
+  turn_remove(&world.cur_map->turn, &world.pc);
+  world.pc.pos[dim_x] = MAP_X - 2;
+  world.pc.pos[dim_y] = world.cur_map->e;
+  world.cur_idx[dim_x]++;
+  new_map(0);
+  turn_insert(&world.cur_map->turn, &world.pc);
+}
+
+static void bench_pathfind()
+{
+  static uint16_t ref[PATHFIND_MAX_FIELDS][MAP_Y][MAP_X];
+  double elapsed[num_pathfind_engines], t;
+  uint32_t calls, mismatches;
+  int i, p, r, e;
+
+  memset(elapsed, 0, sizeof (elapsed));
+  calls = mismatches = 0;
+
+  for (i = 0; i < BENCH_MAPS; i++) {
+    if (i) {
+      bench_next_map();
+    }
+
+    for (p = 0; p < BENCH_POSITIONS; p++) {
+      bench_place_pc();
+      for (e = 0; e < num_pathfind_engines; e++) {
+        t = bench_now();
+        for (r = 0; r < BENCH_REPEATS; r++) {
+          pathfind_with(world.cur_map, (pathfind_engine_t) e);
+        }
+        elapsed[e] += bench_now() - t;
+
+        if (!e) {
+          memcpy(ref, world.dist, sizeof (ref[0]) * pathfind_num_fields());
+        } else if (memcmp(ref, world.dist,
+                          sizeof (ref[0]) * pathfind_num_fields())) {
+          fprintf(stderr, "%s disagrees with %s on map (%d,%d), PC (%d,%d)\n",
+                  pathfind_engine_name[e], pathfind_engine_name[0],
+                  world.cur_idx[dim_x], world.cur_idx[dim_y],
+                  world.pc.pos[dim_x], world.pc.pos[dim_y]);
+          mismatches++;
+        }
+      }
+      calls += BENCH_REPEATS;
+    }
+  }
+
+  printf("pathfind: %d maps, %u calls per engine\n", BENCH_MAPS, calls);
+  printf("  %-12s %10s %12s %10s\n", "engine", "us/call", "calls/sec",
+         "speedup");
+  for (e = 0; e < num_pathfind_engines; e++) {
+    printf("  %-12s %10.2f %12.0f %9.2fx\n", pathfind_engine_name[e],
+           elapsed[e] * 1000000.0 / calls, calls / elapsed[e],
+           elapsed[0] / elapsed[e]);
+  }
+  if (mismatches) {
+    printf("  %u mismatched distance maps!\n", mismatches);
+  }
+}
+
+/* A random step for the PC, standing in for the player */
+static void bench_pc_step(pair_t dest)
+{
+  int i, k, x, y;
+
+  dest[dim_x] = world.pc.pos[dim_x];
+  dest[dim_y] = world.pc.pos[dim_y];
+
+  for (i = 0, k = rand() & 0x7; i < 8; i++, k = (k + 1) & 0x7) {
+    x = world.pc.pos[dim_x] + all_dirs[k][dim_x];
+    y = world.pc.pos[dim_y] + all_dirs[k][dim_y];
+    if (x >= 1 && x <= MAP_X - 2 && y >= 1 && y <= MAP_Y - 2 &&
+        !world.cur_map->cmap[y][x]                            &&
+        move_cost[char_pc][world.cur_map->map[y][x]] != INT_MAX) {
+      dest[dim_x] = x;
+      dest[dim_y] = y;
+      return;
+    }
+  }
+}
+
+/* game_loop() without the terminal: the PC wanders at random, and *
+ * every trainer is marked defeated so that nobody starts a battle.  *
+ * If retire is set, hikers and rivals also stop giving chase, as    *
+ * they do once beaten in io_battle().                               */
+static void bench_turns(uint32_t turns, int retire)
+{
+  Character *c;
+  Npc *n;
+  pair_t d;
+  uint32_t i;
+  int x, y;
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      if ((n = dynamic_cast<Npc *>(world.cur_map->cmap[y][x]))) {
+        n->defeated = 1;
+        if (retire && (n->ctype == char_hiker || n->ctype == char_rival)) {
+          n->mtype = move_wander;
+        }
+      }
+    }
+  }
+
+  for (i = 0; i < turns; i++) {
+    c = turn_remove_min(&world.cur_map->turn);
+    n = dynamic_cast<Npc *> (c);
+
+    if (n) {
+      move_func[n->mtype](c, d);
+    } else {
+      bench_pc_step(d);
+    }
+
+    world.cur_map->cmap[c->pos[dim_y]][c->pos[dim_x]] = NULL;
+    world.cur_map->cmap[d[dim_y]][d[dim_x]] = c;
+
+    c->next_turn += move_cost[n ? n->ctype : char_pc]
+                             [world.cur_map->map[d[dim_y]][d[dim_x]]];
+    c->pos[dim_y] = d[dim_y];
+    c->pos[dim_x] = d[dim_x];
+
+    if (!n) {
+      pathfind(world.cur_map);
+    }
+
+    turn_insert(&world.cur_map->turn, c);
+  }
+}
+
+/* Every heap.c user runs on the default backend, so this swaps it  *
+ * out from under map generation (dijkstra_path) and the heap-driven *
+ * pathfinding engine, replaying the same seed.                      */
+static void bench_heaps(uint32_t seed)
+{
+  double map_time[num_heap_backends], path_time[num_heap_backends];
+  double turn_time[num_heap_backends], t;
+  heap_backend_t saved_backend;
+  pathfind_engine_t saved_engine;
+  int b, i, p;
+
+  saved_backend = heap_get_default_backend();
+  saved_engine = pathfind_get_engine();
+  pathfind_set_engine(pathfind_fibonacci);
+
+  for (b = 0; b < num_heap_backends; b++) {
+    heap_set_default_backend((heap_backend_t) b);
+    srand(seed);
+
+    t = bench_now();
+    init_world();
+    for (i = 1; i < BENCH_HEAP_MAPS; i++) {
+      bench_next_map();
+    }
+    map_time[b] = bench_now() - t;
+
+    t = bench_now();
+    for (p = 0; p < BENCH_POSITIONS; p++) {
+      bench_place_pc();
+      for (i = 0; i < BENCH_REPEATS; i++) {
+        pathfind_with(world.cur_map, pathfind_fibonacci);
+      }
+    }
+    path_time[b] = bench_now() - t;
+
+    bench_place_pc();
+    pathfind(world.cur_map);
+    t = bench_now();
+    bench_turns(BENCH_TURNS, 0);
+    turn_time[b] = bench_now() - t;
+
+    delete_world();
+  }
+
+  heap_set_default_backend(saved_backend);
+  pathfind_set_engine(saved_engine);
+
+  printf("heap backends: %d maps, %d pathfinds, %d turns each\n",
+         BENCH_HEAP_MAPS, BENCH_POSITIONS * BENCH_REPEATS, BENCH_TURNS);
+  printf("  %-12s %10s %12s %10s\n", "backend", "maps/sec", "paths/sec",
+         "turns/sec");
+  for (b = 0; b < num_heap_backends; b++) {
+    printf("  %-12s %10.1f %12.1f %10.0f\n", heap_backend_name[b],
+           BENCH_HEAP_MAPS / map_time[b],
+           BENCH_POSITIONS * BENCH_REPEATS / path_time[b],
+           BENCH_TURNS / turn_time[b]);
+  }
+}
+
+/* Costs a character can pay for a move */
+static const int bench_move_costs[] = { 10, 10, 10, 15, 20, 50 };
+
+static void bench_scheduler()
+{
+  static const uint32_t npcs[] = { 10, 100, 1000, 10000 };
+  const uint32_t num_npcs = sizeof (npcs) / sizeof (npcs[0]);
+  const uint32_t num_costs = sizeof (bench_move_costs) /
+                             sizeof (bench_move_costs[0]);
+  Character *chars, *c;
+  turn_queue_t q;
+  heap_t h;
+  double t;
+  uint32_t i, j;
+  int b;
+
+  printf("turn scheduler: %d pops and reschedules, ns/op\n",
+         BENCH_SCHED_OPS);
+  printf("  %-12s", "npcs");
+  for (b = 0; b < num_heap_backends; b++) {
+    printf(" %10s", heap_backend_name[b]);
+  }
+  printf(" %10s\n", "wheel");
+
+  for (i = 0; i < num_npcs; i++) {
+    chars = new Character[npcs[i]];
+    printf("  %-12u", npcs[i]);
+
+    for (b = 0; b < num_heap_backends; b++) {
+      heap_init_backend(&h, (heap_backend_t) b, cmp_char_turns, NULL);
+      heap_set_name(&h, "bench turn queue");
+      for (j = 0; j < npcs[i]; j++) {
+        chars[j].next_turn = 0;
+        heap_insert(&h, chars + j);
+      }
+      srand(npcs[i]);
+      t = bench_now();
+      for (j = 0; j < BENCH_SCHED_OPS; j++) {
+        c = (Character *) heap_remove_min(&h);
+        c->next_turn += bench_move_costs[rand() % num_costs];
+        heap_insert(&h, c);
+      }
+      printf(" %10.1f", (bench_now() - t) * 1000000000.0 / BENCH_SCHED_OPS);
+      heap_delete(&h);
+    }
+
+    turn_init(&q);
+    for (j = 0; j < npcs[i]; j++) {
+      chars[j].next_turn = 0;
+      turn_insert(&q, chars + j);
+    }
+    srand(npcs[i]);
+    t = bench_now();
+    for (j = 0; j < BENCH_SCHED_OPS; j++) {
+      c = turn_remove_min(&q);
+      c->next_turn += bench_move_costs[rand() % num_costs];
+      turn_insert(&q, c);
+    }
+    printf(" %10.1f\n", (bench_now() - t) * 1000000000.0 / BENCH_SCHED_OPS);
+
+    delete [] chars;
+  }
+}
+
+/* Walks the PC around each map five times over the same route:  *
+ * recomputing every step, repairing every step, repairing with    *
+ * the distance-map cache in front, the same with the maps for     *
+ * every next step speculated before it's taken (untimed, as if    *
+ * the player took longer to choose), and then again with every    *
+ * repair and cache hit verified against a recompute.              */
+static void bench_incremental(uint32_t seed)
+{
+  static pair_t walk[BENCH_WALK_STEPS];
+  const pathfind_stats_t *stats;
+  double full_time, repair_time, cache_time, spec_time, t;
+  uint32_t repaired, cached, speculated, foreseen, verified;
+  int i, j;
+
+  srand(seed);
+  init_world();
+  stats = pathfind_get_stats();
+  full_time = repair_time = cache_time = spec_time = 0;
+  repaired = cached = speculated = foreseen = verified = 0;
+
+  for (i = 0; i < BENCH_WALK_MAPS; i++) {
+    if (i) {
+      bench_next_map();
+    }
+
+    for (j = 0; j < BENCH_WALK_STEPS; j++) {
+      bench_pc_step(walk[j]);
+      world.pc.pos[dim_x] = walk[j][dim_x];
+      world.pc.pos[dim_y] = walk[j][dim_y];
+    }
+
+    t = bench_now();
+    for (j = 0; j < BENCH_WALK_STEPS; j++) {
+      world.pc.pos[dim_x] = walk[j][dim_x];
+      world.pc.pos[dim_y] = walk[j][dim_y];
+      pathfind_with(world.cur_map, pathfind_get_engine());
+    }
+    full_time += bench_now() - t;
+
+    repaired -= stats->repaired;
+    pathfind_set_cache(0);
+    t = bench_now();
+    for (j = 0; j < BENCH_WALK_STEPS; j++) {
+      world.pc.pos[dim_x] = walk[j][dim_x];
+      world.pc.pos[dim_y] = walk[j][dim_y];
+      pathfind(world.cur_map);
+      pathfind_need(char_hiker);
+      pathfind_need(char_rival);
+    }
+    repair_time += bench_now() - t;
+    pathfind_set_cache(1);
+    repaired += stats->repaired;
+
+    cached -= stats->cached;
+    pathfind_cache_flush();
+    pathfind_invalidate();
+    t = bench_now();
+    for (j = 0; j < BENCH_WALK_STEPS; j++) {
+      world.pc.pos[dim_x] = walk[j][dim_x];
+      world.pc.pos[dim_y] = walk[j][dim_y];
+      pathfind(world.cur_map);
+      pathfind_need(char_hiker);
+      pathfind_need(char_rival);
+    }
+    cache_time += bench_now() - t;
+    cached += stats->cached;
+
+    speculated -= stats->speculated;
+    foreseen -= stats->foreseen;
+    pathfind_cache_flush();
+    pathfind_invalidate();
+    for (j = 0; j < BENCH_WALK_STEPS; j++) {
+      pathfind_speculate(world.cur_map);
+      pathfind_speculate_wait();
+      t = bench_now();
+      world.pc.pos[dim_x] = walk[j][dim_x];
+      world.pc.pos[dim_y] = walk[j][dim_y];
+      pathfind(world.cur_map);
+      pathfind_need(char_hiker);
+      pathfind_need(char_rival);
+      spec_time += bench_now() - t;
+    }
+    speculated += stats->speculated;
+    foreseen += stats->foreseen;
+
+    verified -= stats->verified;
+    pathfind_set_verify(1);
+    pathfind_cache_flush();
+    pathfind_invalidate();
+    for (j = 0; j < BENCH_WALK_STEPS; j++) {
+      pathfind_speculate(world.cur_map);
+      pathfind_speculate_wait();
+      world.pc.pos[dim_x] = walk[j][dim_x];
+      world.pc.pos[dim_y] = walk[j][dim_y];
+      pathfind(world.cur_map);
+      pathfind_need(char_hiker);
+      pathfind_need(char_rival);
+    }
+    pathfind_set_verify(0);
+    verified += stats->verified;
+  }
+
+  delete_world();
+
+  printf("incremental pathfind: %d maps, %d PC steps each\n",
+         BENCH_WALK_MAPS, BENCH_WALK_STEPS);
+  printf("  %-12s %10.2f us/step\n",
+         pathfind_engine_name[pathfind_get_engine()],
+         full_time * 1000000.0 / (BENCH_WALK_MAPS * BENCH_WALK_STEPS));
+  printf("  %-12s %10.2f us/step, %u of %u maps repaired\n",
+         "incremental",
+         repair_time * 1000000.0 / (BENCH_WALK_MAPS * BENCH_WALK_STEPS),
+         repaired, BENCH_WALK_MAPS * BENCH_WALK_STEPS * pathfind_num_fields());
+  printf("  %-12s %10.2f us/step, %u of %u maps cached, %u verified\n",
+         "cached",
+         cache_time * 1000000.0 / (BENCH_WALK_MAPS * BENCH_WALK_STEPS),
+         cached, BENCH_WALK_MAPS * BENCH_WALK_STEPS * pathfind_num_fields(),
+         verified);
+  printf("  %-12s %10.2f us/step, %u of %u maps foreseen, %.0f%% of %u "
+         "used\n", "speculative",
+         spec_time * 1000000.0 / (BENCH_WALK_MAPS * BENCH_WALK_STEPS),
+         foreseen, BENCH_WALK_MAPS * BENCH_WALK_STEPS * pathfind_num_fields(),
+         100.0 * foreseen / speculated, speculated);
+}
+
+/* A way of playing bench_turns(), for bench_demand() */
+typedef struct bench_demand_mode {
+  const char *name;
+  int retire;
+  int early_exit;
+  int32_t radius;
+  int verify;
+} bench_demand_mode_t;
+
+static const bench_demand_mode_t bench_demand_modes[] = {
+  { "whole map",  0, 0, 0,                   0 },
+  { "chasing",    0, 1, 0,                   0 },
+  { "radius",     0, 1, BENCH_DEMAND_RADIUS, 0 },
+  { "beaten",     1, 1, 0,                   0 },
+  { "verified",   0, 1, BENCH_DEMAND_RADIUS, 1 },
+};
+
+/* Plays the same turns with hikers and rivals in pursuit, computing  *
+ * their distance maps in full, stopping once they're all covered,    *
+ * and stopping at a radius; then with them all beaten; and finally,  *
+ * untimed, with every bounded map checked against a full one.  Counts *
+ * the distance maps each PC move asked for that pathfinding computed  *
+ * in full, bounded, or never had to, and the pathfind() calls that    *
+ * found the PC still where it was.                                    */
+static void bench_demand(uint32_t seed)
+{
+  const bench_demand_mode_t *mode;
+  const pathfind_stats_t *stats;
+  uint32_t full, bounded, avoided, skipped, verified;
+  double t;
+  int i;
+
+  stats = pathfind_get_stats();
+
+  printf("demand-driven pathfind: %d maps, %d turns each, radius %d\n",
+         BENCH_HEAP_MAPS, BENCH_TURNS, BENCH_DEMAND_RADIUS);
+  printf("  %-12s %10s %10s %10s %10s %10s\n", "pursuers", "turns/sec",
+         "full", "bounded", "avoided", "skipped");
+  for (mode = bench_demand_modes;
+       mode < bench_demand_modes + (sizeof (bench_demand_modes) /
+                                    sizeof (bench_demand_modes[0]));
+       mode++) {
+    srand(seed);
+    init_world();
+    pathfind_set_early_exit(mode->early_exit);
+    pathfind_set_radius(mode->radius);
+    pathfind_set_verify(mode->verify);
+    full = -(stats->full + stats->repaired + stats->cached);
+    bounded = -stats->bounded;
+    avoided = -stats->avoided;
+    skipped = -stats->skipped;
+    verified = -stats->verified;
+    t = 0;
+    for (i = 0; i < BENCH_HEAP_MAPS; i++) {
+      if (i) {
+        bench_next_map();
+      }
+      pathfind(world.cur_map);
+      t -= bench_now();
+      bench_turns(BENCH_TURNS, mode->retire);
+      t += bench_now();
+    }
+    full += stats->full + stats->repaired + stats->cached;
+    bounded += stats->bounded;
+    avoided += stats->avoided;
+    skipped += stats->skipped;
+    verified += stats->verified;
+    delete_world();
+
+    if (mode->verify) {
+      printf("  %-12s %10s %10u %10u %10u %10u, %u checked\n", mode->name,
+             "-", full, bounded, avoided, skipped, verified);
+    } else {
+      printf("  %-12s %10.0f %10u %10u %10u %10u\n", mode->name,
+             BENCH_HEAP_MAPS * BENCH_TURNS / t, full, bounded, avoided,
+             skipped);
+    }
+  }
+
+  pathfind_set_early_exit(1);
+  pathfind_set_radius(0);
+  pathfind_set_verify(0);
+}
+
+/* Plays the same turns on maps crowded with hikers and rivals, who *
+ * move by the next-hop tables and then by probing their neighbours;  *
+ * since ties are broken differently, the two runs soon part ways.    */
+static void bench_crowd(uint32_t seed)
+{
+  double t;
+  int i, j, on;
+
+  printf("crowded pursuit: %d maps, %d turns each, %d extra pursuers\n",
+         BENCH_HEAP_MAPS, BENCH_TURNS, BENCH_CROWD);
+  for (on = 1; on >= 0; on--) {
+    srand(seed);
+    init_world();
+    pursuer_set_next_hops(on);
+    t = 0;
+    for (i = 0; i < BENCH_HEAP_MAPS; i++) {
+      if (i) {
+        bench_next_map();
+      }
+      for (j = 0; j < BENCH_CROWD; j++) {
+        if (j & 1) {
+          new_rival();
+        } else {
+          new_hiker();
+        }
+      }
+      pathfind(world.cur_map);
+      t -= bench_now();
+      bench_turns(BENCH_TURNS, 0);
+      t += bench_now();
+    }
+    delete_world();
+
+    printf("  %-12s %10.0f turns/sec\n", on ? "next hops" : "probing",
+           BENCH_HEAP_MAPS * BENCH_TURNS / t);
+  }
+
+  pursuer_set_next_hops(1);
+}
+
+/* Distances to the nearest of 1, 2, 4 and 8 sources on cells the PC *
+ * could stand on, by pathfind_multi() and by one single-source map   *
+ * per source, merged.  The two must agree, and each cell's owner     *
+ * must be a source at the merged distance.                           */
+static void bench_multi(uint32_t seed)
+{
+  static uint16_t single[BENCH_SOURCES][MAP_Y][MAP_X];
+  static uint16_t merged[MAP_Y][MAP_X], multi[MAP_Y][MAP_X];
+  static uint8_t owner[MAP_Y][MAP_X];
+  pair_t src[BENCH_SOURCES];
+  double elapsed[2], t;
+  uint32_t runs, mismatches;
+  int i, p, k, j, x, y, ctype;
+
+  printf("multi-source: %d maps, %d source sets each, hikers and rivals\n",
+         BENCH_WALK_MAPS, BENCH_POSITIONS);
+  printf("  %-8s %14s %14s %10s\n", "sources", "us one pass",
+         "us per source", "speedup");
+
+  for (k = 1; k <= BENCH_SOURCES; k *= 2) {
+    srand(seed);
+    init_world();
+    elapsed[0] = elapsed[1] = 0;
+    runs = mismatches = 0;
+
+    for (i = 0; i < BENCH_WALK_MAPS; i++) {
+      if (i) {
+        bench_next_map();
+      }
+
+      for (p = 0; p < BENCH_POSITIONS; p++) {
+        for (j = 0; j < k; j++) {
+          bench_place_pc();
+          src[j][dim_x] = world.pc.pos[dim_x];
+          src[j][dim_y] = world.pc.pos[dim_y];
+        }
+
+        for (ctype = char_hiker; ctype <= char_rival; ctype++) {
+          t = bench_now();
+          pathfind_multi(world.cur_map, (character_type_t) ctype, src, k,
+                         multi, owner);
+          elapsed[0] += bench_now() - t;
+
+          t = bench_now();
+          for (j = 0; j < k; j++) {
+            pathfind_multi(world.cur_map, (character_type_t) ctype,
+                           src + j, 1, single[j], NULL);
+          }
+          for (y = 0; y < MAP_Y; y++) {
+            for (x = 0; x < MAP_X; x++) {
+              merged[y][x] = single[0][y][x];
+              for (j = 1; j < k; j++) {
+                if (single[j][y][x] < merged[y][x]) {
+                  merged[y][x] = single[j][y][x];
+                }
+              }
+            }
+          }
+          elapsed[1] += bench_now() - t;
+          runs++;
+
+          for (y = 0; y < MAP_Y; y++) {
+            for (x = 0; x < MAP_X; x++) {
+              if (multi[y][x] != merged[y][x] ||
+                  (merged[y][x] == PATHFIND_INF) !=
+                  (owner[y][x] == PATHFIND_NO_OWNER) ||
+                  (owner[y][x] != PATHFIND_NO_OWNER &&
+                   single[owner[y][x]][y][x] != merged[y][x])) {
+                fprintf(stderr, "%d-source %s distance at (%d,%d) on map "
+                        "(%d,%d) disagrees with one map per source\n", k,
+                        char_type_name[ctype], x, y,
+                        world.cur_idx[dim_x], world.cur_idx[dim_y]);
+                mismatches++;
+              }
+            }
+          }
+        }
+      }
+    }
+    delete_world();
+
+    printf("  %-8d %14.2f %14.2f %9.2fx\n", k,
+           elapsed[0] * 1000000.0 / runs, elapsed[1] * 1000000.0 / runs,
+           elapsed[1] / elapsed[0]);
+    if (mismatches) {
+      printf("  %u mismatched cells!\n", mismatches);
+    }
+  }
+}
+
+/* Routes from random cells to the PC, by path_query() with and      *
+ * without landmarks, and read off a whole distance map; all three    *
+ * must agree, since paying for the cells entered on the way in is    *
+ * paying for the cells left on the way out.  Landmark tables are     *
+ * built inside the timing, the first time each map is queried.       */
+static void bench_query(uint32_t seed)
+{
+  static pair_t from[num_character_types][BENCH_QUERIES];
+  static const char *const name[] = { "A* octile", "A* landmarks" };
+  const pathfind_stats_t *stats;
+  double map_time, query_time[2], t;
+  uint32_t queries[2], expanded[2], landmarks, mismatches;
+  int i, p, q, f, a;
+  int32_t cost;
+
+  srand(seed);
+  init_world();
+  stats = pathfind_get_stats();
+  map_time = query_time[0] = query_time[1] = 0;
+  queries[0] = queries[1] = expanded[0] = expanded[1] = 0;
+  landmarks = -stats->landmarks;
+  mismatches = 0;
+
+  for (i = 0; i < BENCH_WALK_MAPS; i++) {
+    if (i) {
+      bench_next_map();
+    }
+
+    for (p = 0; p < BENCH_POSITIONS; p++) {
+      bench_place_pc();
+      t = bench_now();
+      pathfind_with(world.cur_map, pathfind_fused);
+      map_time += bench_now() - t;
+
+      for (f = char_hiker; f < num_character_types; f++) {
+        for (q = 0; q < BENCH_QUERIES; q++) {
+          do {
+            rand_pos(from[f][q]);
+          } while (move_cost[f][world.cur_map->map[from[f][q][dim_y]]
+                                                  [from[f][q][dim_x]]] ==
+                   INT_MAX);
+        }
+      }
+
+      for (a = 0; a < 2; a++) {
+        pathfind_set_landmarks(a);
+        queries[a] -= stats->queries;
+        expanded[a] -= stats->expanded;
+        for (f = char_hiker; f < num_character_types; f++) {
+          for (q = 0; q < BENCH_QUERIES; q++) {
+            t = bench_now();
+            cost = path_query(world.cur_map, from[f][q], world.pc.pos,
+                              (character_type_t) f, NULL);
+            query_time[a] += bench_now() - t;
+            if ((cost == INT_MAX ? PATHFIND_INF : cost) !=
+                pathfind_dist((character_type_t) f)
+                             [from[f][q][dim_y]][from[f][q][dim_x]]) {
+              fprintf(stderr, "%s disagrees with %s distances from "
+                      "(%d,%d) to (%d,%d)\n", name[a], char_type_name[f],
+                      from[f][q][dim_x], from[f][q][dim_y],
+                      world.pc.pos[dim_x], world.pc.pos[dim_y]);
+              mismatches++;
+            }
+          }
+        }
+        queries[a] += stats->queries;
+        expanded[a] += stats->expanded;
+      }
+    }
+  }
+  landmarks += stats->landmarks;
+  delete_world();
+  pathfind_set_landmarks(1);
+
+  printf("point-to-point routes: %d maps, %d PC positions each, "
+         "%u landmark tables\n", BENCH_WALK_MAPS, BENCH_POSITIONS, landmarks);
+  for (a = 0; a < 2; a++) {
+    printf("  %-12s %10.2f us/route, %.0f cells settled per route\n",
+           name[a], query_time[a] * 1000000.0 / queries[a],
+           (double) expanded[a] / queries[a]);
+  }
+  printf("  %-12s %10.2f us/position, both distance maps\n", "fused",
+         map_time * 1000000.0 / (BENCH_WALK_MAPS * BENCH_POSITIONS));
+  if (mismatches) {
+    printf("  %u mismatched routes!\n", mismatches);
+  }
+}
+
+int bench_main(uint32_t seed)
+{
+  init_world();
+
+  bench_pathfind();
+
+  delete_world();
+
+  bench_heaps(seed);
+
+  bench_scheduler();
+
+  bench_incremental(seed);
+
+  bench_demand(seed);
+
+  bench_crowd(seed);
+
+  bench_multi(seed);
+
+  bench_query(seed);
+
+  return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef BENCH_H
+# define BENCH_H
+
+# include <stdint.h>
+
+int bench_main(uint32_t seed);
+
+#endif
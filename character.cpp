@@ -1,8 +1,10 @@
+#include <stdlib.h>
 #include <limits.h>
 
 #include "character.h"
 #include "poke327.h"
 #include "io.h"
+#include "pathfind.h"
 
 /***********************************************************************
  * Hack: Avoid the "path to a building" issue by making building cells *
@@ -25,64 +27,106 @@ const char *char_type_name[num_character_types] = {
   "Trainer",
 };
 
-static void move_hiker_func(Character *c, pair_t dest)
+static int next_hops = 1;
+
+/* Whether pursuers move by the next-hop tables, or by looking at each *
+ * of their neighbours' distances as they used to.  For the bench.     */
+void pursuer_set_next_hops(int on)
 {
+  next_hops = on;
+}
+
+/* Hikers and rivals alike: step downhill in the distance map for the *
+ * pursuer's own type, so any type with a move_cost row gets a chase.  */
+static void move_pursuer_probe(Character *c, pair_t dest)
+{
+  Npc *n = dynamic_cast<Npc *>(c);
+  Character **cmap;
+  const uint16_t *dist;
   int min;
   int base;
-  int i;
+  int i, k, o;
 
   base = rand() & 0x7;
+  pathfind_need_near(n->ctype, c->pos);
+  dist = pathfind_dist(n->ctype)[0];
+  cmap = world.cur_map->cmap[0];
+  o = map_grid::index(c->pos[dim_x], c->pos[dim_y]);
 
   dest[dim_x] = c->pos[dim_x];
   dest[dim_y] = c->pos[dim_y];
-  min = INT_MAX;
+  min = PATHFIND_INF;
   
   for (i = base; i < 8 + base; i++) {
-    if ((world.hiker_dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
-                         [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] <=
-         min) &&
-        !world.cur_map->cmap[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
-                            [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]]) {
-      dest[dim_x] = c->pos[dim_x] + all_dirs[i & 0x7][dim_x];
-      dest[dim_y] = c->pos[dim_y] + all_dirs[i & 0x7][dim_y];
-      min = world.hiker_dist[dest[dim_y]][dest[dim_x]];
+    k = i & 0x7;
+    if (dist[o + map_grid::step[k]] < min && !cmap[o + map_grid::step[k]]) {
+      dest[dim_x] = c->pos[dim_x] + all_dirs[k][dim_x];
+      dest[dim_y] = c->pos[dim_y] + all_dirs[k][dim_y];
+      min = dist[o + map_grid::step[k]];
     }
-    if (world.hiker_dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
-                        [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] == 0) {
+    if (dist[o + map_grid::step[k]] == 0) {
       io_battle(c, &world.pc);
       break;
     }
   }
 }
 
-static void move_rival_func(Character *c, pair_t dest)
+/* The same moves from the next-hop table: the best neighbours come *
+ * straight out of it, and only if they're all occupied does the    *
+ * pursuer fall back to looking around for the next best.  Only a   *
+ * tie costs a call to rand().                                       */
+static void move_pursuer_func(Character *c, pair_t dest)
 {
-  int min;
+  Npc *n = dynamic_cast<Npc *>(c);
+  Character **cmap;
+  uint32_t hops, open;
   int base;
-  int i;
-  
-  base = rand() & 0x7;
+  int k, o;
+
+  if (!next_hops) {
+    move_pursuer_probe(c, dest);
+    return;
+  }
 
   dest[dim_x] = c->pos[dim_x];
   dest[dim_y] = c->pos[dim_y];
-  min = INT_MAX;
-  
-  for (i = base; i < 8 + base; i++) {
-    if ((world.rival_dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
-                         [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] <
-         min) &&
-        !world.cur_map->cmap[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
-                            [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]]) {
-      dest[dim_x] = c->pos[dim_x] + all_dirs[i & 0x7][dim_x];
-      dest[dim_y] = c->pos[dim_y] + all_dirs[i & 0x7][dim_y];
-      min = world.rival_dist[dest[dim_y]][dest[dim_x]];
-    }
-    if (world.rival_dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
-                        [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] == 0) {
-      io_battle(c, &world.pc);
-      break;
+
+  /* The PC's cell is the only one at distance zero */
+  if (abs(world.pc.pos[dim_x] - c->pos[dim_x]) <= 1 &&
+      abs(world.pc.pos[dim_y] - c->pos[dim_y]) <= 1) {
+    io_battle(c, &world.pc);
+    return;
+  }
+
+  pathfind_need_near(n->ctype, c->pos);
+  if (!(hops = pathfind_next_hops(n->ctype, c->pos))) {
+    return;
+  }
+
+  cmap = world.cur_map->cmap[0];
+  o = map_grid::index(c->pos[dim_x], c->pos[dim_y]);
+  for (open = 0, k = 0; k < 8; k++) {
+    if ((hops & (1U << k)) && !cmap[o + map_grid::step[k]]) {
+      open |= 1U << k;
     }
   }
+
+  if (!open) {
+    move_pursuer_probe(c, dest);
+    return;
+  }
+
+  if (open & (open - 1)) {
+    /* Rotate a random start down to bit 0, as the probe does */
+    base = rand() & 0x7;
+    k = (base + __builtin_ctz(((open >> base) | (open << (8 - base))) &
+                              0xff)) & 0x7;
+  } else {
+    k = __builtin_ctz(open);
+  }
+
+  dest[dim_x] = c->pos[dim_x] + all_dirs[k][dim_x];
+  dest[dim_y] = c->pos[dim_y] + all_dirs[k][dim_y];
 }
 
 static void move_pacer_func(Character *c, pair_t dest)
@@ -203,8 +247,8 @@ static void move_pc_func(Character *c, pair_t dest)
 }
 
 void (*move_func[num_movement_types])(Character *, pair_t) = {
-  move_hiker_func,
-  move_rival_func,
+  move_pursuer_func,
+  move_pursuer_func,
   move_pacer_func,
   move_wanderer_func,
   move_sentry_func,
@@ -223,239 +267,3 @@ void delete_character(void *v)
     delete (Npc *) v;
   }
 }
-
-#define ter_cost(x, y, c) move_cost[c][m->map[y][x]]
-
-static int32_t hiker_cmp(const void *key, const void *with) {
-  return (world.hiker_dist[((path_t *) key)->pos[dim_y]]
-                          [((path_t *) key)->pos[dim_x]] -
-          world.hiker_dist[((path_t *) with)->pos[dim_y]]
-                          [((path_t *) with)->pos[dim_x]]);
-}
-
-static int32_t rival_cmp(const void *key, const void *with) {
-  return (world.rival_dist[((path_t *) key)->pos[dim_y]]
-                          [((path_t *) key)->pos[dim_x]] -
-          world.rival_dist[((path_t *) with)->pos[dim_y]]
-                          [((path_t *) with)->pos[dim_x]]);
-}
-
-void pathfind(Map *m)
-{
-  heap_t h;
-  uint32_t x, y;
-  static path_t p[MAP_Y][MAP_X], *c;
-  static uint32_t initialized = 0;
-
-  if (!initialized) {
-    initialized = 1;
-    for (y = 0; y < MAP_Y; y++) {
-      for (x = 0; x < MAP_X; x++) {
-        p[y][x].pos[dim_y] = y;
-        p[y][x].pos[dim_x] = x;
-      }
-    }
-  }
-
-  for (y = 0; y < MAP_Y; y++) {
-    for (x = 0; x < MAP_X; x++) {
-      world.hiker_dist[y][x] = world.rival_dist[y][x] = INT_MAX;
-    }
-  }
-  world.hiker_dist[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = 
-    world.rival_dist[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = 0;
-
-  heap_init(&h, hiker_cmp, NULL);
-
-  for (y = 1; y < MAP_Y - 1; y++) {
-    for (x = 1; x < MAP_X - 1; x++) {
-      if (ter_cost(x, y, char_hiker) != INT_MAX) {
-        p[y][x].hn = heap_insert(&h, &p[y][x]);
-      } else {
-        p[y][x].hn = NULL;
-      }
-    }
-  }
-
-  while ((c = (path_t *) heap_remove_min(&h))) {
-    c->hn = NULL;
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x] - 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x] - 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn) &&
-        (world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x]    ] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x]    ] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x] + 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x] + 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y]    ][c->pos[dim_x] - 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y]    ][c->pos[dim_x] - 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y]    ][c->pos[dim_x] + 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y]    ][c->pos[dim_x] + 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x] - 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x] - 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn) &&
-        (world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x]    ] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x]    ] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x] + 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x] + 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn);
-    }
-  }
-  heap_delete(&h);
-
-  heap_init(&h, rival_cmp, NULL);
-
-  for (y = 1; y < MAP_Y - 1; y++) {
-    for (x = 1; x < MAP_X - 1; x++) {
-      if (ter_cost(x, y, char_rival) != INT_MAX) {
-        p[y][x].hn = heap_insert(&h, &p[y][x]);
-      } else {
-        p[y][x].hn = NULL;
-      }
-    }
-  }
-
-  while ((c = (path_t *) heap_remove_min(&h))) {
-    c->hn = NULL;
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn) &&
-        (world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x] - 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x] - 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn) &&
-        (world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x]    ] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x]    ] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn) &&
-        (world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x] + 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x] + 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn) &&
-        (world.rival_dist[c->pos[dim_y]    ][c->pos[dim_x] - 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y]    ][c->pos[dim_x] - 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn) &&
-        (world.rival_dist[c->pos[dim_y]    ][c->pos[dim_x] + 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y]    ][c->pos[dim_x] + 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn) &&
-        (world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x] - 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x] - 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn) &&
-        (world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x]    ] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x]    ] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn) &&
-        (world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x] + 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x] + 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn);
-    }
-  }
-  heap_delete(&h);
-}
@@ -16,8 +16,8 @@ class Character;
 
 int32_t cmp_char_turns(const void *key, const void *with);
 void delete_character(void *v);
-void pathfind(Map *m);
 
 int pc_move(char);
+void pursuer_set_next_hops(int on);
 
 #endif
@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "encounter.h"
+#include "db_parse.h"
+
+/**************************************************************************
+ * Wild encounter tables.  Each (terrain, distance band) pair gets a      *
+ * table of species weighted by capture rate, habitat affinity with the  *
+ * terrain, evolution stage and rarity.  Tables are built the first time *
+ * they're needed, then sampled in constant time with Vose's alias       *
+ * method: pick a column uniformly, then flip a biased coin between the  *
+ * column's own species and its alias.                                    *
+ **************************************************************************/
+
+typedef struct encounter_entry {
+  uint32_t threshold; /* Keep species if rand() is below this */
+  uint16_t species;
+  uint16_t alias;
+} encounter_entry_t;
+
+typedef struct encounter_table {
+  encounter_entry_t *entry;
+  uint32_t size;
+} encounter_table_t;
+
+static encounter_table_t tables[num_terrain_types][ENCOUNTER_NUM_BANDS];
+
+/* Indexed by habitat_id.  0 is used for species with no habitat in the  *
+ * database (everything after generation 3), which are equally at home   *
+ * anywhere.  Habitats are: cave, forest, grassland, mountain, rare,     *
+ * rough-terrain, sea, urban and waters-edge.  There's no water on the   *
+ * maps, so sea species get a small weight on open ground instead:       *
+ * grass, clearings, paths and exits.                                    */
+#define NUM_HABITATS 10
+
+static uint32_t habitat_affinity[num_terrain_types][NUM_HABITATS] = {
+  /*                none cave for gra mou rar rou sea urb wat */
+  /* boulder  */  {   2,   4,  1,  1,  4,  1,  4,  0,  1,  1 },
+  /* tree     */  {   2,   0,  8,  2,  1,  1,  1,  0,  1,  1 },
+  /* path     */  {   2,   0,  1,  3,  1,  1,  1,  1,  6,  1 },
+  /* mart     */  {   2,   0,  0,  1,  0,  1,  0,  0,  8,  1 },
+  /* center   */  {   2,   0,  0,  1,  0,  1,  0,  0,  8,  1 },
+  /* grass    */  {   2,   0,  3,  8,  1,  1,  1,  1,  1,  2 },
+  /* clearing */  {   2,   0,  2,  6,  1,  1,  1,  1,  3,  2 },
+  /* mountain */  {   2,   4,  1,  1,  8,  1,  4,  0,  0,  1 },
+  /* forest   */  {   2,   1,  8,  2,  1,  1,  1,  0,  0,  2 },
+  /* exit     */  {   2,   0,  1,  3,  1,  1,  1,  1,  6,  1 },
+};
+
+static uint64_t species_weight(const pokemon_species_db *s,
+                               terrain_type_t ter, int band)
+{
+  uint64_t w;
+
+  if (s->capture_rate <= 0) {
+    return 0;
+  }
+
+  if ((s->is_legendary > 0 || s->is_mythical > 0) &&
+      band < ENCOUNTER_LEGENDARY_BAND) {
+    return 0;
+  }
+
+  w = s->capture_rate * habitat_affinity[ter][s->habitat_id > 0 &&
+                                              s->habitat_id < NUM_HABITATS ?
+                                              s->habitat_id : 0];
+
+  /* Evolved forms become more common further from the center */
+  if (s->evolves_from_species_id > 0) {
+    w = (w * (band + 1)) / ENCOUNTER_NUM_BANDS;
+  }
+
+  return w;
+}
+
+static void build_table(encounter_table_t *t, terrain_type_t ter, int band)
+{
+  uint64_t *weight, total;
+  double *p;
+  uint32_t *small, *large;
+  uint32_t num_small, num_large;
+  uint32_t i, n, l, g;
+  const uint32_t num_species = (sizeof (species) / sizeof (species[0])) - 1;
+
+  weight = (uint64_t *) malloc(num_species * sizeof (*weight));
+  t->entry = (encounter_entry_t *) malloc(num_species * sizeof (*t->entry));
+
+  /* species[] is 1-indexed */
+  for (total = 0, n = 0, i = 1; i <= num_species; i++) {
+    if ((weight[n] = species_weight(species + i, ter, band))) {
+      t->entry[n].species = t->entry[n].alias = i;
+      total += weight[n++];
+    }
+  }
+
+  if (!n) {
+    /* Nothing lives here.  Shouldn't happen, but be uniform about it. */
+    for (i = 0; i < num_species; i++) {
+      t->entry[i].threshold = (uint32_t) RAND_MAX + 1;
+      t->entry[i].species = t->entry[i].alias = i + 1;
+    }
+    t->size = num_species;
+    free(weight);
+
+    return;
+  }
+
+  p = (double *) malloc(n * sizeof (*p));
+  small = (uint32_t *) malloc(n * sizeof (*small));
+  large = (uint32_t *) malloc(n * sizeof (*large));
+
+  t->size = n;
+  for (num_small = num_large = 0, i = 0; i < n; i++) {
+    p[i] = ((double) weight[i] * n) / total;
+    if (p[i] < 1.0) {
+      small[num_small++] = i;
+    } else {
+      large[num_large++] = i;
+    }
+  }
+
+  while (num_small && num_large) {
+    l = small[--num_small];
+    g = large[--num_large];
+    t->entry[l].threshold = (uint32_t) (p[l] * ((double) RAND_MAX + 1.0));
+    t->entry[l].alias = t->entry[g].species;
+    p[g] = (p[g] + p[l]) - 1.0;
+    if (p[g] < 1.0) {
+      small[num_small++] = g;
+    } else {
+      large[num_large++] = g;
+    }
+  }
+
+  /* Whatever is left over is 1 to within rounding error */
+  while (num_large) {
+    t->entry[large[--num_large]].threshold = (uint32_t) RAND_MAX + 1;
+  }
+  while (num_small) {
+    t->entry[small[--num_small]].threshold = (uint32_t) RAND_MAX + 1;
+  }
+
+  free(large);
+  free(small);
+  free(p);
+  free(weight);
+}
+
+int encounter_distance(void)
+{
+  return (abs(world.cur_idx[dim_x] - (WORLD_SIZE / 2)) +
+          abs(world.cur_idx[dim_y] - (WORLD_SIZE / 2)));
+}
+
+int encounter_species(terrain_type_t ter, int distance)
+{
+  encounter_table_t *t;
+  encounter_entry_t *e;
+  int band;
+
+  band = distance / ENCOUNTER_BAND_SIZE;
+  if (band < 0) {
+    band = 0;
+  }
+  if (band >= ENCOUNTER_NUM_BANDS) {
+    band = ENCOUNTER_NUM_BANDS - 1;
+  }
+
+  t = &tables[ter][band];
+  if (!t->entry) {
+    build_table(t, ter, band);
+  }
+
+  e = t->entry + (rand() % t->size);
+
+  return ((uint32_t) rand() < e->threshold) ? e->species : e->alias;
+}
+
+void encounter_delete_tables(void)
+{
+  int t, b;
+
+  for (t = 0; t < num_terrain_types; t++) {
+    for (b = 0; b < ENCOUNTER_NUM_BANDS; b++) {
+      if (tables[t][b].entry) {
+        free(tables[t][b].entry);
+        tables[t][b].entry = NULL;
+        tables[t][b].size = 0;
+      }
+    }
+  }
+}
@@ -0,0 +1,19 @@
+#ifndef ENCOUNTER_H
+# define ENCOUNTER_H
+
+# include "poke327.h"
+
+/* Distance from the world center is bucketed into bands of this many *
+ * maps.  Each (terrain, band) pair gets its own encounter table.     */
+# define ENCOUNTER_BAND_SIZE   50
+# define ENCOUNTER_NUM_BANDS   ((WORLD_SIZE / ENCOUNTER_BAND_SIZE) + 1)
+
+/* Legendary and mythical species don't appear closer to the center *
+ * than this band.                                                  */
+# define ENCOUNTER_LEGENDARY_BAND 4
+
+int encounter_distance(void);
+int encounter_species(terrain_type_t ter, int distance);
+void encounter_delete_tables(void);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef GRID_H
+# define GRID_H
+
+# include <stdint.h>
+
+/**************************************************************************
+ * Flattened grids.  A W by H map stored row by row in one array, so a   *
+ * cell's neighbours are fixed offsets from its index.  The ring of      *
+ * cells around the edge is the padding: a kernel fills it with a        *
+ * sentinel (a wall, an infinite distance) and only ever steps from the  *
+ * cells inside it, so it needs no bounds checks.  The maps' own         *
+ * borders of boulders and exits are impassable to every NPC already,    *
+ * which makes the terrain its own sentinel for them.  Everything here   *
+ * is a compile-time constant, so a kernel templated on its grid can     *
+ * unroll its loops over step[] into eight fixed displacements.          *
+ **************************************************************************/
+
+template <int W, int H>
+struct grid {
+  static constexpr int width = W;
+  static constexpr int height = H;
+  static constexpr int cells = W * H;
+
+  static constexpr int16_t index(int x, int y) { return y * W + x; }
+  static constexpr bool inner(int x, int y)
+  {
+    return x >= 1 && x <= W - 2 && y >= 1 && y <= H - 2;
+  }
+
+  /* The eight neighbours, in all_dirs' order */
+  static constexpr int16_t step[8] = {
+    -W - 1, -1, W - 1, -W, W, -W + 1, 1, W + 1
+  };
+  /* The four orthogonal ones: up, left, right, down */
+  static constexpr int16_t step4[4] = { -W, -1, 1, W };
+};
+
+#endif
@@ -13,8 +13,29 @@ struct heap_node {
   void *datum;
   uint32_t degree;
   uint32_t mark;
+  uint32_t index; /* Position in the 4-ary heap's array */
 };
 
+/* Slabs are chained newest first; only the newest is partially used. */
+#define HEAP_SLAB_NODES 512
+
+struct heap_slab {
+  heap_slab_t *next;
+  heap_node_t node[HEAP_SLAB_NODES];
+};
+
+#ifdef HEAP_STATS
+# define stat_add(h, field, n) ((h)->stats.field += (n))
+# define stat_max(h, field, v) ({             \
+  if ((v) > (h)->stats.field) {               \
+    (h)->stats.field = (v);                   \
+  }                                           \
+})
+#else
+# define stat_add(h, field, n)
+# define stat_max(h, field, v)
+#endif
+
 #define swap(a, b) ({    \
   typeof (a) _tmp = (a); \
   (a) = (b);             \
@@ -91,16 +112,131 @@ void print_heap_node_list(heap_node_t *n)
   printf("\n");
 }
 
+const char *heap_backend_name[num_heap_backends] = {
+  "fibonacci",
+  "pairing",
+  "4-ary",
+};
+
+static heap_backend_t default_backend = heap_fibonacci;
+
+void heap_set_default_backend(heap_backend_t b)
+{
+  default_backend = b;
+}
+
+heap_backend_t heap_get_default_backend(void)
+{
+  return default_backend;
+}
+
+int heap_find_backend(const char *name)
+{
+  int i;
+
+  for (i = 0; i < num_heap_backends; i++) {
+    if (!strcmp(name, heap_backend_name[i])) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
 void heap_init(heap_t *h,
                int32_t (*compare)(const void *key, const void *with),
                void (*datum_delete)(void *))
+{
+  heap_init_backend(h, default_backend, compare, datum_delete);
+}
+
+void heap_init_backend(heap_t *h, heap_backend_t backend,
+                       int32_t (*compare)(const void *key, const void *with),
+                       void (*datum_delete)(void *))
 {
   h->min = NULL;
   h->size = 0;
+  h->free = NULL;
+  h->slab = NULL;
+  h->slab_used = 0;
+  h->backend = backend;
+  h->array = NULL;
+  h->array_size = 0;
   h->compare = compare;
   h->datum_delete = datum_delete;
+  h->name = NULL;
+  heap_stats_reset(h);
+}
+
+void heap_set_name(heap_t *h, const char *name)
+{
+  h->name = name;
+}
+
+void heap_stats_reset(heap_t *h)
+{
+#ifdef HEAP_STATS
+  memset(&h->stats, 0, sizeof (h->stats));
+#endif
+}
+
+void heap_stats_print(heap_t *h, FILE *f)
+{
+#ifdef HEAP_STATS
+  fprintf(f, "heap %s (%s): size %u, max size %u\n"
+             "  insert %llu  remove_min %llu  decrease_key %llu  "
+             "consolidate %llu\n"
+             "  roots per consolidate %.1f, max %u  max degree %u\n"
+             "  cuts %llu  cascades %llu  longest cascade %u\n",
+          h->name ? h->name : "(unnamed)", heap_backend_name[h->backend],
+          h->size, h->stats.max_size,
+          (unsigned long long) h->stats.inserts,
+          (unsigned long long) h->stats.remove_mins,
+          (unsigned long long) h->stats.decrease_keys,
+          (unsigned long long) h->stats.consolidates,
+          h->stats.consolidates ?
+          (double) h->stats.roots / h->stats.consolidates : 0.0,
+          h->stats.max_roots, h->stats.max_degree,
+          (unsigned long long) h->stats.cuts,
+          (unsigned long long) h->stats.cascades, h->stats.max_cascade);
+#else
+  fprintf(f, "heap %s: built without HEAP_STATS\n",
+          h->name ? h->name : "(unnamed)");
+#endif
+}
+
+static heap_node_t *heap_node_alloc(heap_t *h)
+{
+  heap_node_t *n;
+  heap_slab_t *s;
+
+  if ((n = h->free)) {
+    h->free = n->next;
+  } else {
+    if (!h->slab || h->slab_used == HEAP_SLAB_NODES) {
+      assert((s = malloc(sizeof (*s))));
+      s->next = h->slab;
+      h->slab = s;
+      h->slab_used = 0;
+    }
+    n = h->slab->node + h->slab_used++;
+  }
+
+  memset(n, 0, sizeof (*n));
+
+  return n;
 }
 
+static void heap_node_free(heap_t *h, heap_node_t *n)
+{
+  n->next = h->free;
+  h->free = n;
+}
+
+/**************************************************************************
+ * Fibonacci heap.  h->min points into the circular root list.            *
+ **************************************************************************/
+
 void heap_node_delete(heap_t *h, heap_node_t *hn)
 {
   heap_node_t *next;
@@ -114,45 +250,21 @@ void heap_node_delete(heap_t *h, heap_node_t *hn)
     if (h->datum_delete) {
       h->datum_delete(hn->datum);
     }
-    free(hn);
+    heap_node_free(h, hn);
     hn = next;
   }
 }
 
-void heap_delete(heap_t *h)
+static void fibonacci_insert(heap_t *h, heap_node_t *n)
 {
-  if (h->min) {
-    heap_node_delete(h, h->min);
-  }
-  h->min = NULL;
-  h->size = 0;
-  h->compare = NULL;
-  h->datum_delete = NULL;
-}
-
-heap_node_t *heap_insert(heap_t *h, void *v)
-{
-  heap_node_t *n;
-
-  assert((n = calloc(1, sizeof (*n))));
-  n->datum = v;
-
   if (h->min) {
     insert_heap_node_in_list(n, h->min);
   } else {
     n->next = n->prev = n;
   }
-  if (!h->min || (h->compare(v, h->min->datum) < 0)) {
+  if (!h->min || (h->compare(n->datum, h->min->datum) < 0)) {
     h->min = n;
   }
-  h->size++;
-
-  return n;
-}
-
-void *heap_peek_min(heap_t *h)
-{
-  return h->min ? h->min->datum : NULL;
 }
 
 static void heap_link(heap_t *h, heap_node_t *node, heap_node_t *root)
@@ -171,7 +283,7 @@ static void heap_link(heap_t *h, heap_node_t *node, heap_node_t *root)
 
 static void heap_consolidate(heap_t *h)
 {
-  uint32_t i;
+  uint32_t i, roots;
   heap_node_t *x, *y, *n;
   heap_node_t *a[64]; /* Need ceil(lg(h->size)), so this is good  *
                        * to the limit of a 64-bit address space,  *
@@ -181,7 +293,7 @@ static void heap_consolidate(heap_t *h)
 
   h->min->prev->next = NULL;
 
-  for (x = n = h->min; n; x = n) {
+  for (roots = 0, x = n = h->min; n; x = n, roots++) {
     n = n->next;
 
     while (a[x->degree]) {
@@ -193,8 +305,13 @@ static void heap_consolidate(heap_t *h)
       heap_link(h, y, x);
     }
     a[x->degree] = x;
+    stat_max(h, max_degree, x->degree);
   }
 
+  stat_add(h, consolidates, 1);
+  stat_add(h, roots, roots);
+  stat_max(h, max_roots, roots);
+
   for (h->min = NULL, i = 0; i < 64; i++) {
     if (a[i]) {
       if (h->min) {
@@ -210,68 +327,30 @@ static void heap_consolidate(heap_t *h)
   }
 }
 
-void *heap_remove_min(heap_t *h)
+static heap_node_t *fibonacci_remove_min(heap_t *h)
 {
-  void *v;
   heap_node_t *n;
 
-  v = NULL;
-
-  if (h->min) {
-    v = h->min->datum;
-    if (h->size == 1) {
-      free(h->min);
-      h->min = NULL;
-    } else {
-      if ((n = h->min->child)) {
-        for (; n->parent; n = n->next) {
-          n->parent = NULL;
-        }
+  n = h->min;
+  if (h->size == 1) {
+    h->min = NULL;
+  } else {
+    if ((n = h->min->child)) {
+      for (; n->parent; n = n->next) {
+        n->parent = NULL;
       }
-
-      splice_heap_node_lists(h->min, h->min->child);
-
-      n = h->min;
-      remove_heap_node_from_list(n);
-      h->min = n->next;
-      free(n);
-
-      heap_consolidate(h);
     }
 
-    h->size--;
-  }
-
-  return v;
-}
+    splice_heap_node_lists(h->min, h->min->child);
 
-int heap_combine(heap_t *h, heap_t *h1, heap_t *h2)
-{
-  if (h1->compare != h2->compare ||
-      h1->datum_delete != h2->datum_delete) {
-    return 1;
-  }
-
-  h->compare = h1->compare;
-  h->datum_delete = h1->datum_delete;
+    n = h->min;
+    remove_heap_node_from_list(n);
+    h->min = n->next;
 
-  if (!h1->min) {
-    h->min = h2->min;
-    h->size = h2->size;
-  } else if (!h2->min) {
-    h->min = h1->min;
-    h->size = h1->size;
-  } else {
-    h->min = ((h->compare(h1->min->datum, h2->min->datum) < 0) ?
-              h1->min                                          :
-              h2->min);
-    splice_heap_node_lists(h1->min, h2->min);
+    heap_consolidate(h);
   }
 
-  memset(h1, 0, sizeof (*h1));
-  memset(h2, 0, sizeof (*h2));
-
-  return 0;
+  return n;
 }
 
 static void heap_cut(heap_t *h, heap_node_t *n, heap_node_t *p)
@@ -286,9 +365,10 @@ static void heap_cut(heap_t *h, heap_node_t *n, heap_node_t *p)
   n->parent = NULL;
   n->mark = 0;
   insert_heap_node_in_list(n, h->min);
+  stat_add(h, cuts, 1);
 }
 
-static void heap_cascading_cut(heap_t *h, heap_node_t *n)
+static void heap_cascading_cut(heap_t *h, heap_node_t *n, uint32_t depth)
 {
   heap_node_t *p;
 
@@ -297,9 +377,443 @@ static void heap_cascading_cut(heap_t *h, heap_node_t *n)
       n->mark = 1;
     } else {
       heap_cut(h, n, p);
-      heap_cascading_cut(h, n);
+      heap_cascading_cut(h, p, depth + 1);
+      return;
     }
   }
+
+  if (depth) {
+    stat_add(h, cascades, 1);
+    stat_max(h, max_cascade, depth);
+  }
+}
+
+static void fibonacci_decrease_key(heap_t *h, heap_node_t *n)
+{
+  heap_node_t *p;
+
+  p = n->parent;
+
+  if (p && (h->compare(n->datum, p->datum) < 0)) {
+    heap_cut(h, n, p);
+    heap_cascading_cut(h, p, 0);
+  }
+  if (h->compare(n->datum, h->min->datum) < 0) {
+    h->min = n;
+  }
+}
+
+/**************************************************************************
+ * Pairing heap.  h->min is the root.  Children hang off child as a       *
+ * NULL-terminated list through next; prev is the left sibling, or the    *
+ * parent for the leftmost child.  Decrease-key cuts the subtree and      *
+ * melds it back at the root; remove-min is the two-pass merge.           *
+ **************************************************************************/
+
+static heap_node_t *pairing_meld(heap_t *h, heap_node_t *a, heap_node_t *b)
+{
+  if (!a) {
+    return b;
+  }
+  if (!b) {
+    return a;
+  }
+  if (h->compare(b->datum, a->datum) < 0) {
+    swap(a, b);
+  }
+
+  b->next = a->child;
+  if (a->child) {
+    a->child->prev = b;
+  }
+  b->prev = a;
+  a->child = b;
+
+  return a;
+}
+
+static heap_node_t *pairing_merge_pairs(heap_t *h, heap_node_t *first)
+{
+  heap_node_t *a, *b, *rest, *list;
+#ifdef HEAP_STATS
+  uint32_t roots;
+
+  for (roots = 0, a = first; a; a = a->next, roots++)
+    ;
+  stat_add(h, consolidates, 1);
+  stat_add(h, roots, roots);
+  stat_max(h, max_roots, roots);
+  stat_max(h, max_degree, roots);
+#endif
+
+  /* Left to right, meld pairs and stack the results through next */
+  for (list = NULL; first; first = rest) {
+    a = first;
+    if ((b = a->next)) {
+      rest = b->next;
+      b->next = b->prev = NULL;
+    } else {
+      rest = NULL;
+    }
+    a->next = a->prev = NULL;
+    a = pairing_meld(h, a, b);
+    a->next = list;
+    list = a;
+  }
+
+  if (!list) {
+    return NULL;
+  }
+
+  /* Right to left, meld the stack into a single tree */
+  a = list;
+  list = a->next;
+  a->next = NULL;
+  while ((b = list)) {
+    list = b->next;
+    b->next = NULL;
+    a = pairing_meld(h, a, b);
+  }
+
+  return a;
+}
+
+static void pairing_node_delete(heap_t *h, heap_node_t *n)
+{
+  heap_node_t *next;
+
+  for (; n; n = next) {
+    if (n->child) {
+      pairing_node_delete(h, n->child);
+    }
+    next = n->next;
+    if (h->datum_delete) {
+      h->datum_delete(n->datum);
+    }
+    heap_node_free(h, n);
+  }
+}
+
+static heap_node_t *pairing_remove_min(heap_t *h)
+{
+  heap_node_t *n;
+
+  n = h->min;
+  h->min = pairing_merge_pairs(h, n->child);
+
+  return n;
+}
+
+static void pairing_decrease_key(heap_t *h, heap_node_t *n)
+{
+  if (n == h->min) {
+    return;
+  }
+
+  if (n->prev->child == n) {
+    n->prev->child = n->next;
+  } else {
+    n->prev->next = n->next;
+  }
+  if (n->next) {
+    n->next->prev = n->prev;
+  }
+  n->next = n->prev = NULL;
+
+  h->min = pairing_meld(h, h->min, n);
+}
+
+/**************************************************************************
+ * Implicit 4-ary heap.  h->array holds the nodes in heap order and each  *
+ * node's index is its position there, which is what decrease-key needs   *
+ * to find it.  The array only grows, so a cleared heap doesn't allocate. *
+ **************************************************************************/
+
+#define QUATERNARY_PARENT(i) (((i) - 1) >> 2)
+#define QUATERNARY_CHILD(i)  (((i) << 2) + 1)
+
+static void quaternary_sift_up(heap_t *h, uint32_t i)
+{
+  heap_node_t *n;
+  uint32_t p;
+
+  n = h->array[i];
+  while (i &&
+         h->compare(n->datum, h->array[p = QUATERNARY_PARENT(i)]->datum) < 0) {
+    h->array[i] = h->array[p];
+    h->array[i]->index = i;
+    i = p;
+  }
+  h->array[i] = n;
+  n->index = i;
+}
+
+static void quaternary_sift_down(heap_t *h, uint32_t i, uint32_t size)
+{
+  heap_node_t *n;
+  uint32_t c, j, end;
+
+  n = h->array[i];
+  while ((c = QUATERNARY_CHILD(i)) < size) {
+    end = c + 4 < size ? c + 4 : size;
+    for (j = c + 1; j < end; j++) {
+      if (h->compare(h->array[j]->datum, h->array[c]->datum) < 0) {
+        c = j;
+      }
+    }
+    if (h->compare(h->array[c]->datum, n->datum) >= 0) {
+      break;
+    }
+    h->array[i] = h->array[c];
+    h->array[i]->index = i;
+    i = c;
+  }
+  h->array[i] = n;
+  n->index = i;
+}
+
+static void quaternary_reserve(heap_t *h, uint32_t size)
+{
+  if (size > h->array_size) {
+    h->array_size = h->array_size ? h->array_size : 64;
+    while (h->array_size < size) {
+      h->array_size *= 2;
+    }
+    assert((h->array = realloc(h->array,
+                               h->array_size * sizeof (*h->array))));
+  }
+}
+
+static void quaternary_insert(heap_t *h, heap_node_t *n)
+{
+  quaternary_reserve(h, h->size + 1);
+  h->array[h->size] = n;
+  quaternary_sift_up(h, h->size);
+}
+
+static heap_node_t *quaternary_remove_min(heap_t *h)
+{
+  heap_node_t *n;
+
+  n = h->array[0];
+  if (h->size > 1) {
+    h->array[0] = h->array[h->size - 1];
+    quaternary_sift_down(h, 0, h->size - 1);
+  }
+
+  return n;
+}
+
+static void quaternary_node_delete(heap_t *h)
+{
+  uint32_t i;
+
+  for (i = 0; i < h->size; i++) {
+    if (h->datum_delete) {
+      h->datum_delete(h->array[i]->datum);
+    }
+    heap_node_free(h, h->array[i]);
+  }
+}
+
+/**************************************************************************
+ * The public interface dispatches on the heap's backend.                 *
+ **************************************************************************/
+
+void heap_delete(heap_t *h)
+{
+  heap_slab_t *s;
+
+#ifdef HEAP_STATS
+  if (h->stats.inserts) {
+    heap_stats_print(h, stderr);
+  }
+#endif
+
+  heap_clear(h);
+  while ((s = h->slab)) {
+    h->slab = s->next;
+    free(s);
+  }
+  free(h->array);
+  h->array = NULL;
+  h->array_size = 0;
+  h->free = NULL;
+  h->slab_used = 0;
+  h->compare = NULL;
+  h->datum_delete = NULL;
+}
+
+/* Like heap_delete, but the heap keeps its nodes and comparator and is *
+ * ready to be filled again.                                           */
+void heap_clear(heap_t *h)
+{
+  switch (h->backend) {
+  case heap_pairing:
+    pairing_node_delete(h, h->min);
+    break;
+  case heap_quaternary:
+    quaternary_node_delete(h);
+    break;
+  case heap_fibonacci:
+  default:
+    if (h->min) {
+      heap_node_delete(h, h->min);
+    }
+    break;
+  }
+  h->min = NULL;
+  h->size = 0;
+}
+
+heap_node_t *heap_insert(heap_t *h, void *v)
+{
+  heap_node_t *n;
+
+  n = heap_node_alloc(h);
+  n->datum = v;
+
+  switch (h->backend) {
+  case heap_pairing:
+    h->min = pairing_meld(h, h->min, n);
+    break;
+  case heap_quaternary:
+    quaternary_insert(h, n);
+    break;
+  case heap_fibonacci:
+  default:
+    fibonacci_insert(h, n);
+    break;
+  }
+  h->size++;
+  stat_add(h, inserts, 1);
+  stat_max(h, max_size, h->size);
+
+  return n;
+}
+
+void *heap_peek_min(heap_t *h)
+{
+  if (!h->size) {
+    return NULL;
+  }
+
+  return (h->backend == heap_quaternary ? h->array[0] : h->min)->datum;
+}
+
+void *heap_remove_min(heap_t *h)
+{
+  void *v;
+  heap_node_t *n;
+
+  if (!h->size) {
+    return NULL;
+  }
+
+  switch (h->backend) {
+  case heap_pairing:
+    n = pairing_remove_min(h);
+    break;
+  case heap_quaternary:
+    n = quaternary_remove_min(h);
+    break;
+  case heap_fibonacci:
+  default:
+    n = fibonacci_remove_min(h);
+    break;
+  }
+
+  v = n->datum;
+  heap_node_free(h, n);
+  h->size--;
+  stat_add(h, remove_mins, 1);
+
+  return v;
+}
+
+int heap_combine(heap_t *h, heap_t *h1, heap_t *h2)
+{
+  heap_slab_t *s;
+  heap_node_t *n;
+  uint32_t i;
+
+  if (h1->compare != h2->compare           ||
+      h1->datum_delete != h2->datum_delete ||
+      h1->backend != h2->backend) {
+    return 1;
+  }
+
+  h->compare = h1->compare;
+  h->datum_delete = h1->datum_delete;
+  h->backend = h1->backend;
+  h->name = h1->name;
+  heap_stats_reset(h);
+
+  /* h takes over both sets of slabs.  Only h1's newest slab keeps *
+   * handing out fresh nodes; the rest of h2's is simply unused.  */
+  h->slab = h1->slab;
+  h->slab_used = h1->slab_used;
+  if (h->slab) {
+    for (s = h->slab; s->next; s = s->next)
+      ;
+    s->next = h2->slab;
+  } else {
+    h->slab = h2->slab;
+    h->slab_used = h2->slab_used;
+  }
+  h->free = h1->free;
+  if (h->free) {
+    for (n = h->free; n->next; n = n->next)
+      ;
+    n->next = h2->free;
+  } else {
+    h->free = h2->free;
+  }
+
+  h->size = h1->size + h2->size;
+
+  switch (h->backend) {
+  case heap_pairing:
+    h->min = pairing_meld(h, h1->min, h2->min);
+    break;
+  case heap_quaternary:
+    /* Append h2 to h1's array and rebuild bottom up */
+    h->array = h1->array;
+    h->array_size = h1->array_size;
+    quaternary_reserve(h, h->size);
+    for (i = 0; i < h2->size; i++) {
+      h->array[h1->size + i] = h2->array[i];
+      h->array[h1->size + i]->index = h1->size + i;
+    }
+    free(h2->array);
+    for (i = h->size / 4 + 1; i--; ) {
+      if (i < h->size) {
+        quaternary_sift_down(h, i, h->size);
+      }
+    }
+    h->min = NULL;
+    break;
+  case heap_fibonacci:
+  default:
+    if (!h1->min) {
+      h->min = h2->min;
+    } else if (!h2->min) {
+      h->min = h1->min;
+    } else {
+      h->min = ((h->compare(h1->min->datum, h2->min->datum) < 0) ?
+                h1->min                                          :
+                h2->min);
+      splice_heap_node_lists(h1->min, h2->min);
+    }
+    h->array = NULL;
+    h->array_size = 0;
+    break;
+  }
+
+  memset(h1, 0, sizeof (*h1));
+  memset(h2, 0, sizeof (*h2));
+
+  return 0;
 }
 
 int heap_decrease_key(heap_t *h, heap_node_t *n, void *v)
@@ -323,16 +837,19 @@ int heap_decrease_key_no_replace(heap_t *h, heap_node_t *n)
    * user is completely responsible for ensuring that they      *
    * don't fubar the queue.                                     */
 
-  heap_node_t *p;
-
-  p = n->parent;
-
-  if (p && (h->compare(n->datum, p->datum) < 0)) {
-    heap_cut(h, n, p);
-    heap_cascading_cut(h, p);
-  }
-  if (h->compare(n->datum, h->min->datum) < 0) {
-    h->min = n;
+  stat_add(h, decrease_keys, 1);
+
+  switch (h->backend) {
+  case heap_pairing:
+    pairing_decrease_key(h, n);
+    break;
+  case heap_quaternary:
+    quaternary_sift_up(h, n->index);
+    break;
+  case heap_fibonacci:
+  default:
+    fibonacci_decrease_key(h, n);
+    break;
   }
 
   return 0;
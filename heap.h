@@ -5,22 +5,80 @@
 extern "C" {
 # endif
 
+# include <stdio.h>
 # include <stdint.h>
 
 struct heap_node;
 typedef struct heap_node heap_node_t;
+struct heap_slab;
+typedef struct heap_slab heap_slab_t;
 
+/* Every backend supports the whole interface, so callers don't need to *
+ * know which one they've got.  heap_init uses the default backend.     */
+typedef enum heap_backend {
+  heap_fibonacci,
+  heap_pairing,
+  heap_quaternary,
+  num_heap_backends
+} heap_backend_t;
+
+extern const char *heap_backend_name[num_heap_backends];
+
+/* Build with -DHEAP_STATS to have every heap count what it does.     *
+ * The counters are printed when the heap is deleted, or on demand    *
+ * with heap_stats_print.  Without it they cost nothing.  Root counts *
+ * and degrees are per consolidation (Fibonacci) or two-pass merge    *
+ * (pairing); the 4-ary heap has neither.                             */
+# ifdef HEAP_STATS
+typedef struct heap_stats {
+  uint64_t inserts;
+  uint64_t remove_mins;
+  uint64_t decrease_keys;
+  uint64_t consolidates;
+  uint64_t roots;           /* Summed over consolidates */
+  uint32_t max_roots;
+  uint32_t max_degree;
+  uint64_t cuts;            /* Including cascaded ones */
+  uint64_t cascades;        /* Decrease-keys that cascaded */
+  uint32_t max_cascade;     /* Longest chain of cascading cuts */
+  uint32_t max_size;
+} heap_stats_t;
+# endif
+
+/* Nodes are carved out of slabs owned by the heap and recycled through *
+ * a free list, so a heap that is emptied and refilled (see heap_clear) *
+ * stops calling malloc once it has grown to its working size.          */
 typedef struct heap {
   heap_node_t *min;
   uint32_t size;
+  heap_node_t *free;
+  heap_slab_t *slab;
+  uint32_t slab_used;
+  heap_backend_t backend;
+  heap_node_t **array;
+  uint32_t array_size;
   int32_t (*compare)(const void *key, const void *with);
   void (*datum_delete)(void *);
+  const char *name;
+# ifdef HEAP_STATS
+  heap_stats_t stats;
+# endif
 } heap_t;
 
 void heap_init(heap_t *h,
                int32_t (*compare)(const void *key, const void *with),
                void (*datum_delete)(void *));
+void heap_init_backend(heap_t *h, heap_backend_t backend,
+                       int32_t (*compare)(const void *key, const void *with),
+                       void (*datum_delete)(void *));
+void heap_set_default_backend(heap_backend_t b);
+heap_backend_t heap_get_default_backend(void);
+int heap_find_backend(const char *name);
+void heap_set_name(heap_t *h, const char *name);
+void heap_stats_print(heap_t *h, FILE *f);
+void heap_stats_reset(heap_t *h);
 void heap_delete(heap_t *h);
+void heap_clear(heap_t *h);
 heap_node_t *heap_insert(heap_t *h, void *v);
 void *heap_peek_min(heap_t *h);
 void *heap_remove_min(heap_t *h);
@@ -0,0 +1,242 @@
+#ifndef IHEAP_H
+# define IHEAP_H
+
+# include <stdint.h>
+# include <stddef.h>
+# include <string.h>
+
+/**************************************************************************
+ * Intrusive Fibonacci heap.  The same algorithm as heap.c, but the node *
+ * lives inside the queued element and the comparator is a template     *
+ * parameter, so comparisons inline and read keys straight out of the   *
+ * element instead of chasing a callback.  Nothing here allocates; the  *
+ * caller owns every element.  heap.c remains for the C callers and for *
+ * heaps whose element types vary at run time.                          *
+ *                                                                      *
+ * Compare is a functor returning <0, 0, >0 like heap.c's compare.      *
+ **************************************************************************/
+
+template <class T>
+struct iheap_node {
+  T *next;
+  T *prev;
+  T *parent;
+  T *child;
+  uint32_t degree;
+  uint32_t mark;
+};
+
+template <class T, iheap_node<T> T::*Node, class Compare>
+class IHeap {
+ private:
+  T *min;
+  uint32_t count;
+  Compare compare;
+
+  static iheap_node<T> &node(T *t) { return t->*Node; }
+
+  /* Insert t into the circular list before l */
+  static void list_insert(T *t, T *l)
+  {
+    node(t).next = l;
+    node(t).prev = node(l).prev;
+    node(node(t).prev).next = t;
+    node(l).prev = t;
+  }
+
+  static void list_remove(T *t)
+  {
+    node(node(t).next).prev = node(t).prev;
+    node(node(t).prev).next = node(t).next;
+  }
+
+  static void list_splice(T *l1, T *l2)
+  {
+    T *tmp;
+
+    if (l1 && l2) {
+      tmp = node(l1).next;
+      node(tmp).prev = node(l2).prev;
+      node(node(l2).prev).next = tmp;
+      node(l1).next = l2;
+      node(l2).prev = l1;
+    }
+  }
+
+  void link(T *t, T *root)
+  {
+    if (node(root).child) {
+      list_insert(t, node(root).child);
+    } else {
+      node(root).child = t;
+      node(t).next = node(t).prev = t;
+    }
+    node(t).parent = root;
+    node(root).degree++;
+    node(t).mark = 0;
+  }
+
+  void consolidate()
+  {
+    T *a[64], *x, *y, *n, *tmp;
+    uint32_t i;
+
+    memset(a, 0, sizeof (a));
+
+    node(node(min).prev).next = NULL;
+
+    for (x = n = min; n; x = n) {
+      n = node(n).next;
+
+      while (a[node(x).degree]) {
+        y = a[node(x).degree];
+        if (compare(x, y) > 0) {
+          tmp = x;
+          x = y;
+          y = tmp;
+        }
+        a[node(x).degree] = NULL;
+        link(y, x);
+      }
+      a[node(x).degree] = x;
+    }
+
+    for (min = NULL, i = 0; i < 64; i++) {
+      if (a[i]) {
+        if (min) {
+          list_insert(a[i], min);
+          if (compare(a[i], min) < 0) {
+            min = a[i];
+          }
+        } else {
+          min = a[i];
+          node(a[i]).next = node(a[i]).prev = a[i];
+        }
+      }
+    }
+  }
+
+  void cut(T *t, T *p)
+  {
+    if (!--node(p).degree) {
+      node(p).child = NULL;
+    }
+    if (node(p).child == t) {
+      node(p).child = node(t).next;
+    }
+    list_remove(t);
+    node(t).parent = NULL;
+    node(t).mark = 0;
+    list_insert(t, min);
+  }
+
+  void cascading_cut(T *t)
+  {
+    T *p;
+
+    while ((p = node(t).parent)) {
+      if (!node(t).mark) {
+        node(t).mark = 1;
+        break;
+      }
+      cut(t, p);
+      t = p;
+    }
+  }
+
+  static void forget(T *t)
+  {
+    T *n, *c;
+
+    node(node(t).prev).next = NULL;
+    for (; t; t = n) {
+      if ((c = node(t).child)) {
+        forget(c);
+      }
+      n = node(t).next;
+      memset(&node(t), 0, sizeof (node(t)));
+    }
+  }
+
+ public:
+  IHeap() : min(NULL), count(0) {}
+
+  uint32_t size() const { return count; }
+  T *peek_min() const { return min; }
+
+  /* Elements must start with a zeroed node; one that has been removed *
+   * is zeroed again, so this also tells whether t is in the heap.     */
+  static bool queued(T *t) { return node(t).next != NULL; }
+
+  void insert(T *t)
+  {
+    memset(&node(t), 0, sizeof (node(t)));
+
+    if (min) {
+      list_insert(t, min);
+    } else {
+      node(t).next = node(t).prev = t;
+    }
+    if (!min || compare(t, min) < 0) {
+      min = t;
+    }
+    count++;
+  }
+
+  T *remove_min()
+  {
+    T *t, *n;
+
+    if (!(t = min)) {
+      return NULL;
+    }
+
+    if (count == 1) {
+      min = NULL;
+    } else {
+      if ((n = node(t).child)) {
+        for (; node(n).parent; n = node(n).next) {
+          node(n).parent = NULL;
+        }
+      }
+
+      list_splice(t, node(t).child);
+
+      list_remove(t);
+      min = node(t).next;
+
+      consolidate();
+    }
+
+    count--;
+    memset(&node(t), 0, sizeof (node(t)));
+
+    return t;
+  }
+
+  /* t's key has already been lowered in place */
+  void decrease_key(T *t)
+  {
+    T *p;
+
+    if ((p = node(t).parent) && compare(t, p) < 0) {
+      cut(t, p);
+      cascading_cut(p);
+    }
+    if (compare(t, min) < 0) {
+      min = t;
+    }
+  }
+
+  /* Drops everything still queued, leaving their nodes zeroed */
+  void clear()
+  {
+    if (min) {
+      forget(min);
+    }
+    min = NULL;
+    count = 0;
+  }
+};
+
+#endif
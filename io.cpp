@@ -3,11 +3,17 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
+#include <strings.h>
 
 #include "io.h"
 #include "character.h"
 #include "poke327.h"
 #include "pokemon.h"
+#include "encounter.h"
+#include "db_parse.h"
+#include "pokedex.h"
+#include "pathfind.h"
 
 typedef struct io_message {
   /* Will print " --more-- " at end of line when another message follows. *
@@ -18,6 +24,11 @@ typedef struct io_message {
 
 static io_message_t *io_head, *io_tail;
 
+/* The route 'g' is walking the PC along; see io_travel() */
+static path_route_t io_travel_route;
+static uint16_t io_travel_next;
+static const char *io_travel_name;
+
 void io_init_terminal(void)
 {
   initscr();
@@ -106,31 +117,64 @@ static int compare_trainer_distance(const void *v1, const void *v2)
   const Character *const *c1 = (const Character *const *) v1;
   const Character *const *c2 = (const Character *const *) v2;
 
-  return (world.rival_dist[(*c1)->pos[dim_y]][(*c1)->pos[dim_x]] -
-          world.rival_dist[(*c2)->pos[dim_y]][(*c2)->pos[dim_x]]);
+  pathfind_row_t *dist = pathfind_dist(char_rival);
+
+  return (dist[(*c1)->pos[dim_y]][(*c1)->pos[dim_x]] -
+          dist[(*c2)->pos[dim_y]][(*c2)->pos[dim_x]]);
+}
+
+typedef struct io_trainer_estimate {
+  Character *c;
+  int32_t estimate;
+} io_trainer_estimate_t;
+
+static int compare_trainer_estimate(const void *v1, const void *v2)
+{
+  return (((const io_trainer_estimate_t *) v1)->estimate -
+          ((const io_trainer_estimate_t *) v2)->estimate);
 }
 
+/**************************************************************************
+ * Only one trainer matters here, so rather than a whole rival distance  *
+ * map, this asks path_query() for routes to trainers in order of their  *
+ * path_estimate(), stopping once no estimate can beat the best route    *
+ * found.  Usually that's one or two short searches.                     *
+ **************************************************************************/
 static Character *io_nearest_visible_trainer()
 {
-  Character **c, *n;
-  uint32_t x, y, count;
+  io_trainer_estimate_t *c;
+  Character *n;
+  uint32_t x, y, count, i;
+  int32_t best, cost;
 
-  c = (Character **) malloc(world.cur_map->num_trainers * sizeof (*c));
+  c = (io_trainer_estimate_t *) malloc(world.cur_map->num_trainers *
+                                       sizeof (*c));
 
   /* Get a linear list of trainers */
   for (count = 0, y = 1; y < MAP_Y - 1; y++) {
     for (x = 1; x < MAP_X - 1; x++) {
       if (world.cur_map->cmap[y][x] && world.cur_map->cmap[y][x] !=
           &world.pc) {
-        c[count++] = world.cur_map->cmap[y][x];
+        c[count].c = world.cur_map->cmap[y][x];
+        c[count].estimate = path_estimate(world.cur_map, world.pc.pos,
+                                          c[count].c->pos, char_rival);
+        count++;
       }
     }
   }
 
-  /* Sort it by distance from PC */
-  qsort(c, count, sizeof (*c), compare_trainer_distance);
+  /* Sort it by least possible distance from PC */
+  qsort(c, count, sizeof (*c), compare_trainer_estimate);
 
-  n = c[0];
+  /* Nobody reachable still leaves the nearest as the crow flies */
+  n = count ? c[0].c : NULL;
+  for (best = INT_MAX, i = 0; i < count && c[i].estimate < best; i++) {
+    if ((cost = path_query(world.cur_map, world.pc.pos, c[i].c->pos,
+                           char_rival, NULL)) < best) {
+      best = cost;
+      n = c[i].c;
+    }
+  }
 
   free(c);
 
@@ -234,13 +278,15 @@ uint32_t io_teleport_pc(pair_t dest)
 {
   /* Just for fun. And debugging.  Mostly debugging. */
 
+  pathfind_need(char_rival);
   do {
     dest[dim_x] = rand_range(1, MAP_X - 2);
     dest[dim_y] = rand_range(1, MAP_Y - 2);
   } while (world.cur_map->cmap[dest[dim_y]][dest[dim_x]]                  ||
            move_cost[char_pc][world.cur_map->map[dest[dim_y]]
                                                 [dest[dim_x]]] == INT_MAX ||
-           world.rival_dist[dest[dim_y]][dest[dim_x]] < 0);
+           pathfind_dist(char_rival)[dest[dim_y]][dest[dim_x]] ==
+           PATHFIND_INF);
 
   return 0;
 }
@@ -338,6 +384,7 @@ static void io_list_trainers()
   }
 
   /* Sort it by distance from PC */
+  pathfind_need(char_rival);
   qsort(c, count, sizeof (*c), compare_trainer_distance);
 
   /* Display it */
@@ -348,6 +395,247 @@ static void io_list_trainers()
   io_display();
 }
 
+static int io_find_species(const char *name)
+{
+  uint32_t i;
+
+  for (i = 1; i < sizeof (species) / sizeof (species[0]); i++) {
+    if (!strcasecmp(species[i].identifier, name)) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static void io_storage_deposit()
+{
+  int j, key;
+
+  if (world.pc.num_poke < 2) {
+    mvprintw(0, 0, "You can't deposit your last Pokemon.");
+    refresh();
+    getch();
+    return;
+  }
+
+  mvprintw(0, 0, "Deposit which Pokemon?");
+  for (j = 0; j < world.pc.num_poke; j++) {
+    mvprintw(j + 1, 0, " %d. %s%s%s L%d %-40s", j + 1,
+             world.pc.poke.at(j)->is_shiny() ? "*" : "",
+             world.pc.poke.at(j)->get_species(),
+             world.pc.poke.at(j)->is_shiny() ? "*" : "",
+             world.pc.poke.at(j)->get_level(), "");
+  }
+  refresh();
+  key = getch() - '1';
+
+  if (key >= 0 && key < world.pc.num_poke) {
+    world.pc.box.deposit(world.pc.poke.at(key));
+    delete world.pc.poke.at(key);
+    world.pc.poke.erase(world.pc.poke.begin() + key);
+    world.pc.num_poke--;
+  }
+}
+
+/**************************************************************************
+ * The PC storage box.  The box may hold tens of thousands of Pokemon,   *
+ * so the list shown here is always the result of a Storage::query(),    *
+ * which uses the box's species, level and shiny indexes rather than     *
+ * filtering here.                                                       *
+ **************************************************************************/
+static void io_storage_box()
+{
+  static const char *sort_name[num_storage_sorts] = {
+    "slot",
+    "species",
+    "level",
+  };
+  storage_filter_t f = { 0, 0, 0, 0 };
+  storage_sort_t sort = storage_sort_slot;
+  std::vector<uint32_t> list;
+  uint32_t offset, cursor, i;
+  char s[41];
+  int done, level;
+  Pokemon *p;
+
+  offset = cursor = 0;
+
+  for (done = 0; !done;) {
+    world.pc.box.query(f, sort, list);
+    if (cursor >= list.size()) {
+      cursor = list.size() ? list.size() - 1 : 0;
+    }
+    if (cursor < offset) {
+      offset = cursor;
+    }
+    if (cursor >= offset + 13) {
+      offset = cursor - 12;
+    }
+
+    clear();
+    snprintf(s, sizeof (s), "PC box: %u stored, %u shown",
+             world.pc.box.size(), (uint32_t) list.size());
+    mvprintw(3, 19, " %-40s ", s);
+    snprintf(s, sizeof (s), "By %s%s%s%s", sort_name[sort],
+             f.shiny ? ", shiny" : "",
+             f.species ? ", " : "",
+             f.species ? species[f.species].identifier : "");
+    if (f.min_level) {
+      snprintf(s + strlen(s), sizeof (s) - strlen(s), ", L>=%d", f.min_level);
+    }
+    mvprintw(4, 19, " %-40s ", s);
+    mvprintw(5, 19, " %-40s ", "");
+    for (i = 0; i < 13; i++) {
+      if (offset + i < list.size()) {
+        const pokemon_compact &c = world.pc.box.at(list[offset + i]);
+        snprintf(s, sizeof (s), "%5u %s%-16.16s%s L%-3d HP:%d",
+                 list[offset + i],
+                 c.flags & POKEMON_COMPACT_SHINY ? "*" : " ",
+                 species[c.species].identifier,
+                 c.flags & POKEMON_COMPACT_SHINY ? "*" : " ",
+                 c.level, c.hp);
+      } else {
+        s[0] = '\0';
+      }
+      if (offset + i == cursor && list.size()) {
+        attron(A_REVERSE);
+      }
+      mvprintw(i + 6, 19, " %-40s ", s);
+      attroff(A_REVERSE);
+    }
+    mvprintw(19, 19, " %-40s ", "");
+    mvprintw(20, 19, " %-40s ", "w:withdraw d:deposit s:shiny o:order");
+    mvprintw(21, 19, " %-40s ", "/:species l:min level escape:done");
+    refresh();
+
+    switch (getch()) {
+    case KEY_UP:
+      if (cursor) {
+        cursor--;
+      }
+      break;
+    case KEY_DOWN:
+      if (cursor + 1 < list.size()) {
+        cursor++;
+      }
+      break;
+    case KEY_PPAGE:
+      cursor = cursor > 13 ? cursor - 13 : 0;
+      break;
+    case KEY_NPAGE:
+      cursor += 13;
+      break;
+    case 's':
+      f.shiny = !f.shiny;
+      break;
+    case 'o':
+      sort = (storage_sort_t) ((sort + 1) % num_storage_sorts);
+      break;
+    case '/':
+      mvprintw(0, 0, "Species (blank for any): ");
+      refresh();
+      echo();
+      curs_set(1);
+      mvgetnstr(0, 25, s, sizeof (s) - 1);
+      noecho();
+      curs_set(0);
+      f.species = s[0] ? io_find_species(s) : 0;
+      if (f.species < 0) {
+        f.species = 0;
+      }
+      break;
+    case 'l':
+      mvprintw(0, 0, "Minimum level (0 for any): ");
+      refresh();
+      echo();
+      curs_set(1);
+      level = 0;
+      mvscanw(0, 27, (char *) "%d", &level);
+      noecho();
+      curs_set(0);
+      f.min_level = (level > 0 && level <= STORAGE_MAX_LEVEL) ? level : 0;
+      break;
+    case 'w':
+      if (list.size() && world.pc.num_poke < 6) {
+        p = world.pc.box.withdraw(list[cursor]);
+        world.pc.poke.push_back(p);
+        world.pc.num_poke++;
+      }
+      break;
+    case 'd':
+      io_storage_deposit();
+      break;
+    case 27:
+      done = 1;
+      break;
+    }
+  }
+
+  io_display();
+}
+
+/**************************************************************************
+ * In-game Pokedex queries.  Same syntax as poke327 --query; see         *
+ * pokedex.cpp.  Results get the full width of the screen.               *
+ **************************************************************************/
+static void io_pokedex()
+{
+  std::vector<dex_result_t> out;
+  char query[80], err[80], s[81];
+  uint32_t offset, i;
+  int done;
+
+  mvprintw(0, 0, "%-80s", "Query: ");
+  refresh();
+  echo();
+  curs_set(1);
+  mvgetnstr(0, 7, query, sizeof (query) - 8);
+  noecho();
+  curs_set(0);
+
+  if (dex_query(query, out, err, sizeof (err))) {
+    io_queue_message("%s", err);
+    io_display();
+    return;
+  }
+
+  for (offset = 0, done = 0; !done;) {
+    clear();
+    mvprintw(0, 0, "%-80.80s", query);
+    mvprintw(1, 0, "%-80s", dex_format_header());
+    for (i = 0; i < 19; i++) {
+      if (offset + i < out.size()) {
+        dex_format_result(out[offset + i], s, sizeof (s));
+      } else {
+        s[0] = '\0';
+      }
+      mvprintw(i + 2, 0, "%-80s", s);
+    }
+    mvprintw(22, 0, "%lu species.  Arrows to scroll, escape to continue.",
+             (unsigned long) out.size());
+    refresh();
+
+    switch (getch()) {
+    case KEY_UP:
+      if (offset) {
+        offset--;
+      }
+      break;
+    case KEY_DOWN:
+      if (offset + 19 < out.size()) {
+        offset++;
+      }
+      break;
+    case 27:
+      done = 1;
+      break;
+    }
+  }
+
+  io_display();
+}
+
 void io_pokemart()
 {
   mvprintw(0, 0, "Welcome to the Pokemart.  Could I interest you in some Pokeballs?");
@@ -416,6 +704,8 @@ void io_encounter_pokemon()
 {
   Pokemon *p;
   
+  io_travel_route.len = 0;
+
   int md = (abs(world.cur_idx[dim_x] - (WORLD_SIZE / 2)) +
             abs(world.cur_idx[dim_x] - (WORLD_SIZE / 2)));
   int minl, maxl;
@@ -440,7 +730,10 @@ void io_encounter_pokemon()
     maxl = 100;
   }
 
-  p = new Pokemon(rand() % (maxl - minl + 1) + minl);
+  p = new Pokemon(rand() % (maxl - minl + 1) + minl,
+                  encounter_species(world.cur_map->map[world.pc.pos[dim_y]]
+                                                      [world.pc.pos[dim_x]],
+                                    encounter_distance()));
 
 	int pc_poke = 0;
 	int attempt = 0;
@@ -696,11 +989,15 @@ void io_encounter_pokemon()
 		  			if(world.pc.num_poke == 6)
 		  			{
 		  				clear_window();
-		  				mvprintw(11, 26, "The Pokemon got away!");
+		  				mvprintw(11, 26, "You captured the Pokemon!");
+		  				mvprintw(12, 26, "Your party is full, so it was sent to the PC box.");
 		  				refresh();
 		  				getch();
-		  				action_taken = 1;
+		  				world.pc.box.deposit(p);
 		  				delete p;
+		  				world.pc.num_pokeballs--;
+		  				poke_captured = 1;
+		  				action_taken = 1;
 		  			}
 		  			else
 		  			{
@@ -951,6 +1248,8 @@ void io_battle(Character *aggressor, Character *defender)
 	int pc_turn = 1;
 	int npc_turn = 0;
 	
+  io_travel_route.len = 0;
+
   if (!(npc = dynamic_cast<Npc *>(aggressor))) {
     npc = dynamic_cast<Npc *>(defender);
     npc_turn = 0;
@@ -1441,9 +1740,9 @@ void io_teleport_world(pair_t dest)
 
 void io_pick_pokemon()
 {
-	Pokemon *p1 = new Pokemon(1);
-  Pokemon *p2 = new Pokemon(1);
-  Pokemon *p3 = new Pokemon(1);
+	Pokemon *p1 = new Pokemon(1, encounter_species(ter_grass, 0));
+  Pokemon *p2 = new Pokemon(1, encounter_species(ter_grass, 0));
+  Pokemon *p3 = new Pokemon(1, encounter_species(ter_grass, 0));
 	std::cout << "Pick a starting Pokemon\n1. " << p1->get_species() << "\n2. " <<  
   		p2->get_species() << "\n3. " << p3->get_species() << std::endl;
   		
@@ -1486,13 +1785,158 @@ void io_pick_pokemon()
   world.pc.num_poke++;
 }
 
+/**************************************************************************
+ * Travel.  'g' walks the PC to the Pokemart, the Pokemon Center or an   *
+ * exit along a path_query() route, one step per turn so that everybody *
+ * else still gets to move.  A battle, an encounter, or anybody standing *
+ * in the way ends the walk early.                                       *
+ **************************************************************************/
+
+#define IO_TRAVEL_DELAY 50000 /* Microseconds per step, to watch it go */
+
+/* Of the cells of terrain t, the one nearest the PC as the crow flies */
+static int io_find_terrain(terrain_type_t t, pair_t found)
+{
+  int x, y, d, best;
+
+  for (best = INT_MAX, y = 1; y < MAP_Y - 1; y++) {
+    for (x = 1; x < MAP_X - 1; x++) {
+      if (world.cur_map->map[y][x] == t &&
+          (d = (abs(x - world.pc.pos[dim_x]) +
+                abs(y - world.pc.pos[dim_y]))) < best) {
+        best = d;
+        found[dim_x] = x;
+        found[dim_y] = y;
+      }
+    }
+  }
+
+  return best == INT_MAX;
+}
+
+static uint32_t io_travel_step(pair_t dest)
+{
+  uint32_t turn_not_consumed;
+  int16_t *next;
+  int dx, dy;
+
+  next = io_travel_route.step[io_travel_next++];
+  dx = next[dim_x] - world.pc.pos[dim_x];
+  dy = next[dim_y] - world.pc.pos[dim_y];
+
+  if (world.cur_map->cmap[next[dim_y]][next[dim_x]]) {
+    io_travel_route.len = 0;
+    mvprintw(0, 0, "Somebody is in the way.");
+    return 1;
+  }
+
+  usleep(IO_TRAVEL_DELAY);
+
+  /* The numeric keypad: 7 8 9 across the top row */
+  if ((turn_not_consumed = move_pc_dir((1 - dy) * 3 + dx + 2, dest))) {
+    io_travel_route.len = 0;
+  } else if (io_travel_next == io_travel_route.len) {
+    io_travel_route.len = 0;
+    io_queue_message("You have arrived at %s.", io_travel_name);
+  }
+
+  return turn_not_consumed;
+}
+
+static uint32_t io_travel(pair_t dest)
+{
+  pair_t to;
+  int8_t gate;
+  int key;
+
+  mvprintw(0, 0, "Travel to the (m)art, (c)enter, or (n)orth, (s)outh, "
+           "(e)ast or (w)est exit? ");
+  refresh();
+
+  gate = 0;
+  switch (key = getch()) {
+  case 'm':
+    io_travel_name = "the Pokemart";
+    gate = io_find_terrain(ter_mart, to) ? -1 : 0;
+    break;
+  case 'c':
+    io_travel_name = "the Pokemon Center";
+    gate = io_find_terrain(ter_center, to) ? -1 : 0;
+    break;
+  case 'n':
+    io_travel_name = "the north exit";
+    to[dim_x] = gate = world.cur_map->n;
+    to[dim_y] = 1;
+    break;
+  case 's':
+    io_travel_name = "the south exit";
+    to[dim_x] = gate = world.cur_map->s;
+    to[dim_y] = MAP_Y - 2;
+    break;
+  case 'e':
+    io_travel_name = "the east exit";
+    to[dim_x] = MAP_X - 2;
+    to[dim_y] = gate = world.cur_map->e;
+    break;
+  case 'w':
+    io_travel_name = "the west exit";
+    to[dim_x] = 1;
+    to[dim_y] = gate = world.cur_map->w;
+    break;
+  default:
+    mvprintw(0, 0, "%-80s", "Never mind.");
+    return 1;
+  }
+
+  if (gate == -1) {
+    mvprintw(0, 0, "There is no %-68s", io_travel_name + 4);
+    return 1;
+  }
+
+  if (path_query(world.cur_map, world.pc.pos, to, char_pc,
+                 &io_travel_route) == INT_MAX) {
+    io_travel_route.len = 0;
+    mvprintw(0, 0, "There's no way to %-62s", io_travel_name);
+    return 1;
+  }
+
+  /* Exits are on the border, where routes don't go; the last step out *
+   * is a straight one from the path cell inside, as it has to be.     */
+  if (key != 'm' && key != 'c') {
+    io_travel_route.step[io_travel_route.len][dim_x] =
+      to[dim_x] + (key == 'e') - (key == 'w');
+    io_travel_route.step[io_travel_route.len][dim_y] =
+      to[dim_y] + (key == 's') - (key == 'n');
+    io_travel_route.len++;
+  }
+
+  if (!io_travel_route.len) {
+    mvprintw(0, 0, "%-80s", "You're already there.");
+    return 1;
+  }
+
+  io_travel_next = 0;
+
+  return io_travel_step(dest);
+}
+
 void io_handle_input(pair_t dest)
 {
   uint32_t turn_not_consumed;
   int key;
 
+  /* Walking somewhere with 'g' takes the next step without asking */
+  if (io_travel_route.len && !io_travel_step(dest)) {
+    return;
+  }
+
   do {
-    switch (key = getch()) {
+    /* The next move's distance maps get computed while we wait */
+    pathfind_speculate(world.cur_map);
+    key = getch();
+    pathfind_speculate_stop();
+
+    switch (key) {
     case '7':
     case 'y':
     case KEY_HOME:
@@ -1561,6 +2005,9 @@ void io_handle_input(pair_t dest)
       io_teleport_world(dest);
       turn_not_consumed = 0;
       break;
+    case 'g':
+      turn_not_consumed = io_travel(dest);
+      break;
     case 'm':
       io_list_trainers();
       turn_not_consumed = 1;
@@ -1569,6 +2016,14 @@ void io_handle_input(pair_t dest)
     	io_world_bag();
     	turn_not_consumed = 1;
     	break;
+    case 'P':
+      io_storage_box();
+      turn_not_consumed = 1;
+      break;
+    case 'D':
+      io_pokedex();
+      turn_not_consumed = 1;
+      break;
     case 'q':
       /* Demonstrate use of the message queue.  You can use this for *
        * printf()-style debugging (though gdb is probably a better   *
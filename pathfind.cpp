@@ -0,0 +1,2047 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+#include "pathfind.h"
+#include "character.h"
+#include "poke327.h"
+
+const char *pathfind_engine_name[num_pathfind_engines] = {
+  "fibonacci",
+  "intrusive",
+  "dial",
+  "fused",
+  "chamfer",
+};
+
+static pathfind_engine_t engine = pathfind_fused;
+
+#define ter_cost(x, y, c) move_cost[c][m->map[y][x]]
+
+/* Engines compute any subset of the distance maps, given as a mask */
+#define FIELD(f)   (1U << (f))
+#define ALL_FIELDS (FIELD(num_fields) - 1)
+
+/**************************************************************************
+ * Cost profiles.  Each NPC type's row of move_cost is hashed, and types  *
+ * whose rows match share a field, whose distances are computed with the *
+ * costs of the first type to have them.  The rows are rehashed on every *
+ * pathfind(), which is a few dozen multiplies, so a change to move_cost *
+ * regroups the types and throws away anything computed for the old     *
+ * grouping.                                                             *
+ **************************************************************************/
+
+static int num_fields;
+static character_type_t field_ctype[PATHFIND_MAX_FIELDS];
+static int type_field[num_character_types]; /* -1 for the PC */
+static uint32_t type_hash[num_character_types];
+
+static void forget_fields(void);
+
+/* FNV-1a over the row's bytes */
+static uint32_t profile_hash(character_type_t ctype)
+{
+  const uint8_t *b;
+  uint32_t h;
+  size_t i;
+
+  b = (const uint8_t *) move_cost[ctype];
+  for (h = 2166136261U, i = 0; i < sizeof (move_cost[ctype]); i++) {
+    h = (h ^ b[i]) * 16777619U;
+  }
+
+  return h;
+}
+
+static void profiles(void)
+{
+  uint32_t h[num_character_types];
+  int c, f;
+
+  for (c = char_hiker; c < num_character_types; c++) {
+    h[c] = profile_hash((character_type_t) c);
+  }
+  if (num_fields && !memcmp(h + char_hiker, type_hash + char_hiker,
+                            sizeof (h) - sizeof (h[0]) * char_hiker)) {
+    return;
+  }
+
+  num_fields = 0;
+  type_field[char_pc] = -1;
+  for (c = char_hiker; c < num_character_types; c++) {
+    type_hash[c] = h[c];
+    for (f = 0; f < num_fields; f++) {
+      if (h[field_ctype[f]] == h[c] &&
+          !memcmp(move_cost[field_ctype[f]], move_cost[c],
+                  sizeof (move_cost[c]))) {
+        break;
+      }
+    }
+    if (f == num_fields) {
+      field_ctype[num_fields++] = (character_type_t) c;
+    }
+    type_field[c] = f;
+  }
+
+  forget_fields();
+}
+
+/* The index in world.dist of the distance map ctype's moves are costed *
+ * by; -1 for the PC, who has none.                                     */
+int pathfind_field(character_type_t ctype)
+{
+  if (!num_fields) {
+    profiles();
+  }
+
+  return type_field[ctype];
+}
+
+int pathfind_num_fields(void)
+{
+  if (!num_fields) {
+    profiles();
+  }
+
+  return num_fields;
+}
+
+pathfind_row_t *pathfind_dist(character_type_t ctype)
+{
+  return world.dist[pathfind_field(ctype)];
+}
+
+/* For fibonacci_pathfind()'s heap, which compares by the field it's *
+ * currently computing.                                              */
+static pathfind_row_t *fibonacci_dist;
+
+static int32_t dist_cmp(const void *key, const void *with) {
+  return (fibonacci_dist[((path_t *) key)->pos[dim_y]]
+                        [((path_t *) key)->pos[dim_x]] -
+          fibonacci_dist[((path_t *) with)->pos[dim_y]]
+                        [((path_t *) with)->pos[dim_x]]);
+}
+
+static void fibonacci_pathfind(Map *m, unsigned fields)
+{
+  /* Kept across calls so that their nodes are recycled */
+  static heap_t heap[PATHFIND_MAX_FIELDS];
+  character_type_t ctype;
+  pathfind_row_t *dist;
+  heap_t *h;
+  uint32_t x, y;
+  static path_t p[MAP_Y][MAP_X], *c;
+  static uint32_t initialized = 0;
+  int f;
+
+  if (!initialized || heap[0].backend != heap_get_default_backend()) {
+    /* First call, or the default backend has changed under us */
+    for (f = 0; f < PATHFIND_MAX_FIELDS; f++) {
+      heap_delete(&heap[f]);
+      heap_init(&heap[f], dist_cmp, NULL);
+      heap_set_name(&heap[f], "pathfind");
+    }
+  }
+
+  if (!initialized) {
+    initialized = 1;
+    for (y = 0; y < MAP_Y; y++) {
+      for (x = 0; x < MAP_X; x++) {
+        p[y][x].pos[dim_y] = y;
+        p[y][x].pos[dim_x] = x;
+      }
+    }
+  }
+
+  for (f = 0; f < num_fields; f++) {
+    if (fields & FIELD(f)) {
+      for (y = 0; y < MAP_Y; y++) {
+        for (x = 0; x < MAP_X; x++) {
+          world.dist[f][y][x] = PATHFIND_INF;
+        }
+      }
+      world.dist[f][world.pc.pos[dim_y]][world.pc.pos[dim_x]] = 0;
+    }
+  }
+
+  for (f = 0; f < num_fields; f++) {
+    if (!(fields & FIELD(f))) {
+      continue;
+    }
+    h = &heap[f];
+    fibonacci_dist = dist = world.dist[f];
+    ctype = field_ctype[f];
+
+    for (y = 1; y < MAP_Y - 1; y++) {
+      for (x = 1; x < MAP_X - 1; x++) {
+        if (ter_cost(x, y, ctype) != INT_MAX) {
+          p[y][x].hn = heap_insert(h, &p[y][x]);
+        } else {
+          p[y][x].hn = NULL;
+        }
+      }
+    }
+
+    while ((c = (path_t *) heap_remove_min(h))) {
+      c->hn = NULL;
+      if (dist[c->pos[dim_y]][c->pos[dim_x]] == PATHFIND_INF) {
+        /* Everything left is unreachable */
+        break;
+      }
+      if ((p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn) &&
+          (dist[c->pos[dim_y] - 1][c->pos[dim_x] - 1] >
+           dist[c->pos[dim_y]][c->pos[dim_x]] +
+           ter_cost(c->pos[dim_x], c->pos[dim_y], ctype))) {
+        dist[c->pos[dim_y] - 1][c->pos[dim_x] - 1] =
+          dist[c->pos[dim_y]][c->pos[dim_x]] +
+          ter_cost(c->pos[dim_x], c->pos[dim_y], ctype);
+        heap_decrease_key_no_replace(h, p[c->pos[dim_y] - 1]
+                                         [c->pos[dim_x] - 1].hn);
+      }
+      if ((p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn) &&
+          (dist[c->pos[dim_y] - 1][c->pos[dim_x]    ] >
+           dist[c->pos[dim_y]][c->pos[dim_x]] +
+           ter_cost(c->pos[dim_x], c->pos[dim_y], ctype))) {
+        dist[c->pos[dim_y] - 1][c->pos[dim_x]    ] =
+          dist[c->pos[dim_y]][c->pos[dim_x]] +
+          ter_cost(c->pos[dim_x], c->pos[dim_y], ctype);
+        heap_decrease_key_no_replace(h, p[c->pos[dim_y] - 1]
+                                         [c->pos[dim_x]    ].hn);
+      }
+      if ((p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn) &&
+          (dist[c->pos[dim_y] - 1][c->pos[dim_x] + 1] >
+           dist[c->pos[dim_y]][c->pos[dim_x]] +
+           ter_cost(c->pos[dim_x], c->pos[dim_y], ctype))) {
+        dist[c->pos[dim_y] - 1][c->pos[dim_x] + 1] =
+          dist[c->pos[dim_y]][c->pos[dim_x]] +
+          ter_cost(c->pos[dim_x], c->pos[dim_y], ctype);
+        heap_decrease_key_no_replace(h, p[c->pos[dim_y] - 1]
+                                         [c->pos[dim_x] + 1].hn);
+      }
+      if ((p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn) &&
+          (dist[c->pos[dim_y]    ][c->pos[dim_x] - 1] >
+           dist[c->pos[dim_y]][c->pos[dim_x]] +
+           ter_cost(c->pos[dim_x], c->pos[dim_y], ctype))) {
+        dist[c->pos[dim_y]    ][c->pos[dim_x] - 1] =
+          dist[c->pos[dim_y]][c->pos[dim_x]] +
+          ter_cost(c->pos[dim_x], c->pos[dim_y], ctype);
+        heap_decrease_key_no_replace(h, p[c->pos[dim_y]    ]
+                                         [c->pos[dim_x] - 1].hn);
+      }
+      if ((p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn) &&
+          (dist[c->pos[dim_y]    ][c->pos[dim_x] + 1] >
+           dist[c->pos[dim_y]][c->pos[dim_x]] +
+           ter_cost(c->pos[dim_x], c->pos[dim_y], ctype))) {
+        dist[c->pos[dim_y]    ][c->pos[dim_x] + 1] =
+          dist[c->pos[dim_y]][c->pos[dim_x]] +
+          ter_cost(c->pos[dim_x], c->pos[dim_y], ctype);
+        heap_decrease_key_no_replace(h, p[c->pos[dim_y]    ]
+                                         [c->pos[dim_x] + 1].hn);
+      }
+      if ((p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn) &&
+          (dist[c->pos[dim_y] + 1][c->pos[dim_x] - 1] >
+           dist[c->pos[dim_y]][c->pos[dim_x]] +
+           ter_cost(c->pos[dim_x], c->pos[dim_y], ctype))) {
+        dist[c->pos[dim_y] + 1][c->pos[dim_x] - 1] =
+          dist[c->pos[dim_y]][c->pos[dim_x]] +
+          ter_cost(c->pos[dim_x], c->pos[dim_y], ctype);
+        heap_decrease_key_no_replace(h, p[c->pos[dim_y] + 1]
+                                         [c->pos[dim_x] - 1].hn);
+      }
+      if ((p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn) &&
+          (dist[c->pos[dim_y] + 1][c->pos[dim_x]    ] >
+           dist[c->pos[dim_y]][c->pos[dim_x]] +
+           ter_cost(c->pos[dim_x], c->pos[dim_y], ctype))) {
+        dist[c->pos[dim_y] + 1][c->pos[dim_x]    ] =
+          dist[c->pos[dim_y]][c->pos[dim_x]] +
+          ter_cost(c->pos[dim_x], c->pos[dim_y], ctype);
+        heap_decrease_key_no_replace(h, p[c->pos[dim_y] + 1]
+                                         [c->pos[dim_x]    ].hn);
+      }
+      if ((p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn) &&
+          (dist[c->pos[dim_y] + 1][c->pos[dim_x] + 1] >
+           dist[c->pos[dim_y]][c->pos[dim_x]] +
+           ter_cost(c->pos[dim_x], c->pos[dim_y], ctype))) {
+        dist[c->pos[dim_y] + 1][c->pos[dim_x] + 1] =
+          dist[c->pos[dim_y]][c->pos[dim_x]] +
+          ter_cost(c->pos[dim_x], c->pos[dim_y], ctype);
+        heap_decrease_key_no_replace(h, p[c->pos[dim_y] + 1]
+                                         [c->pos[dim_x] + 1].hn);
+      }
+    }
+    heap_clear(h);
+  }
+
+}
+
+/**************************************************************************
+ * The Fibonacci heap again, but the templated intrusive one: keys live  *
+ * in path_t::cost beside the node, and the comparison inlines.          *
+ **************************************************************************/
+
+struct path_cost_cmp {
+  int32_t operator()(const path_t *key, const path_t *with) const
+  {
+    return (key->cost > with->cost) - (key->cost < with->cost);
+  }
+};
+
+typedef IHeap<path_t, &path_t::node, path_cost_cmp> path_heap_t;
+
+static void intrusive_dist(Map *m, character_type_t ctype,
+                           uint16_t dist[MAP_Y][MAP_X])
+{
+  static path_t p[MAP_Y][MAP_X];
+  static uint32_t initialized = 0;
+  path_heap_t h;
+  path_t *c, *n;
+  int32_t d;
+  int x, y, k;
+
+  if (!initialized) {
+    initialized = 1;
+    for (y = 0; y < MAP_Y; y++) {
+      for (x = 0; x < MAP_X; x++) {
+        p[y][x].pos[dim_y] = y;
+        p[y][x].pos[dim_x] = x;
+      }
+    }
+  }
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      p[y][x].cost = INT_MAX;
+    }
+  }
+  c = &p[world.pc.pos[dim_y]][world.pc.pos[dim_x]];
+  c->cost = 0;
+
+  /* Unlike heap.c's callers, cells are queued only once they're reached, *
+   * so the heap holds the frontier rather than the whole map.            */
+  if (ter_cost(c->pos[dim_x], c->pos[dim_y], ctype) != INT_MAX) {
+    h.insert(c);
+  }
+
+  while ((c = h.remove_min())) {
+    d = c->cost + ter_cost(c->pos[dim_x], c->pos[dim_y], ctype);
+    for (k = 0; k < 8; k++) {
+      x = c->pos[dim_x] + all_dirs[k][dim_x];
+      y = c->pos[dim_y] + all_dirs[k][dim_y];
+      if (x < 1 || x > MAP_X - 2 || y < 1 || y > MAP_Y - 2 ||
+          ter_cost(x, y, ctype) == INT_MAX || p[y][x].cost <= d) {
+        continue;
+      }
+      n = &p[y][x];
+      n->cost = d;
+      if (path_heap_t::queued(n)) {
+        h.decrease_key(n);
+      } else {
+        h.insert(n);
+      }
+    }
+  }
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      dist[y][x] = (p[y][x].cost < PATHFIND_INF ? p[y][x].cost :
+                    PATHFIND_INF);
+    }
+  }
+}
+
+static void intrusive_pathfind(Map *m, unsigned fields)
+{
+  int f;
+
+  for (f = 0; f < num_fields; f++) {
+    if (fields & FIELD(f)) {
+      intrusive_dist(m, field_ctype[f], world.dist[f]);
+    }
+  }
+}
+
+/**************************************************************************
+ * Dial's algorithm.  Finite move costs are small integers (at most 50), *
+ * so a circular array of buckets indexed by distance modulo the bucket  *
+ * count replaces the Fibonacci heap: every cell still queued has a      *
+ * distance within one maximum edge weight of the current one.  Buckets  *
+ * are intrusive doubly linked lists threaded through the cells, so a    *
+ * decrease-key is an O(1) unlink and relink, and nothing is allocated.  *
+ **************************************************************************/
+
+#define DIAL_BUCKETS 64 /* Power of two greater than any finite move cost */
+#define DIAL_NONE    -1
+#define DIAL_OUT     -2 /* In prev: not in any bucket */
+#define DIAL_WALL    UINT8_MAX /* In dial_cost: never entered */
+
+static int16_t dial_next[map_grid::cells], dial_prev[map_grid::cells];
+static uint8_t dial_cost[map_grid::cells];
+
+/* cost for ctype: the cost of leaving each cell, or DIAL_WALL for the *
+ * border and for anything ctype can't enter, so that dial_kernel()    *
+ * can step from any cell it settles without checking bounds.          */
+template <class G>
+static void dial_costs(const terrain_type_t *ter, character_type_t ctype,
+                       uint8_t *cost)
+{
+  int32_t w;
+  int x, y;
+
+  for (y = 0; y < G::height; y++) {
+    for (x = 0; x < G::width; x++) {
+      w = move_cost[ctype][ter[G::index(x, y)]];
+      if (!G::inner(x, y) || w == INT_MAX) {
+        cost[G::index(x, y)] = DIAL_WALL;
+      } else {
+        assert(w < DIAL_BUCKETS);
+        cost[G::index(x, y)] = w;
+      }
+    }
+  }
+}
+
+/* Runs Dial's algorithm out from the count cells in start, whose     *
+ * distances in dist must be final and within DIAL_BUCKETS of each     *
+ * other; walls among them are left alone.  Every other cell holds an  *
+ * upper bound (PATHFIND_INF if nothing better is known), and only     *
+ * improvements on those are propagated.  If owner isn't NULL, a cell  *
+ * reached through another inherits its owner.  Returns nonzero if     *
+ * distances saturated, leaving cells PATHFIND_INF that could be       *
+ * reached.                                                            */
+template <class G>
+static int dial_kernel(const uint8_t *cost, uint16_t *dist,
+                       const int16_t *start, int count, uint8_t *owner)
+{
+  static uint32_t initialized = 0;
+  int16_t head[DIAL_BUCKETS];
+  int32_t cur, d;
+  uint32_t queued;
+  int16_t i, n;
+  int k, saturated;
+
+  if (!initialized) {
+    initialized = 1;
+    for (i = 0; i < G::cells; i++) {
+      dial_prev[i] = DIAL_OUT;
+    }
+  }
+
+  for (k = 0; k < DIAL_BUCKETS; k++) {
+    head[k] = DIAL_NONE;
+  }
+
+  for (cur = INT32_MAX, k = 0; k < count; k++) {
+    if (dist[start[k]] < cur) {
+      cur = dist[start[k]];
+    }
+  }
+  for (queued = 0, k = 0; k < count; k++) {
+    i = start[k];
+    if (cost[i] == DIAL_WALL || dial_prev[i] != DIAL_OUT) {
+      continue;
+    }
+    assert(dist[i] - cur < DIAL_BUCKETS);
+    dial_prev[i] = DIAL_NONE;
+    dial_next[i] = head[dist[i] & (DIAL_BUCKETS - 1)];
+    if (dial_next[i] != DIAL_NONE) {
+      dial_prev[dial_next[i]] = i;
+    }
+    head[dist[i] & (DIAL_BUCKETS - 1)] = i;
+    queued++;
+  }
+  saturated = 0;
+
+  for (; queued; cur++) {
+    while ((i = head[cur & (DIAL_BUCKETS - 1)]) != DIAL_NONE) {
+      head[cur & (DIAL_BUCKETS - 1)] = dial_next[i];
+      if (dial_next[i] != DIAL_NONE) {
+        dial_prev[dial_next[i]] = DIAL_NONE;
+      }
+      dial_prev[i] = DIAL_OUT;
+      queued--;
+
+      if ((d = cur + cost[i]) >= PATHFIND_INF) {
+        saturated = 1;
+        continue;
+      }
+
+      for (k = 0; k < 8; k++) {
+        n = i + G::step[k];
+        if (cost[n] == DIAL_WALL || dist[n] <= d) {
+          continue;
+        }
+
+        if (dial_prev[n] != DIAL_OUT) {
+          /* Already queued at a larger distance; unlink it */
+          if (dial_prev[n] != DIAL_NONE) {
+            dial_next[dial_prev[n]] = dial_next[n];
+          } else {
+            head[dist[n] & (DIAL_BUCKETS - 1)] = dial_next[n];
+          }
+          if (dial_next[n] != DIAL_NONE) {
+            dial_prev[dial_next[n]] = dial_prev[n];
+          }
+        } else {
+          queued++;
+        }
+
+        dist[n] = d;
+        if (owner) {
+          owner[n] = owner[i];
+        }
+        dial_prev[n] = DIAL_NONE;
+        dial_next[n] = head[d & (DIAL_BUCKETS - 1)];
+        if (dial_next[n] != DIAL_NONE) {
+          dial_prev[dial_next[n]] = n;
+        }
+        head[d & (DIAL_BUCKETS - 1)] = n;
+      }
+    }
+  }
+
+  return saturated;
+}
+
+/* dial_kernel() on m for ctype.  start must be an inner cell *
+ * that ctype can enter.                                       */
+static int dial_propagate(Map *m, character_type_t ctype,
+                          uint16_t dist[MAP_Y][MAP_X], int16_t start)
+{
+  dial_costs<map_grid>(m->map[0], ctype, dial_cost);
+  assert(dial_cost[start] != DIAL_WALL);
+  return dial_kernel<map_grid>(dial_cost, dist[0], &start, 1, NULL);
+}
+
+/* The distance map from pc, for a PC standing there */
+static void dial_dist(Map *m, character_type_t ctype, const pair_t pc,
+                      uint16_t dist[MAP_Y][MAP_X])
+{
+  int16_t x, y;
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      dist[y][x] = PATHFIND_INF;
+    }
+  }
+
+  dist[pc[dim_y]][pc[dim_x]] = 0;
+  if (ter_cost(pc[dim_x], pc[dim_y], ctype) == INT_MAX) {
+    return;
+  }
+
+  dial_propagate(m, ctype, dist, pc[dim_y] * MAP_X + pc[dim_x]);
+}
+
+static void dial_pathfind(Map *m, unsigned fields)
+{
+  int f;
+
+  for (f = 0; f < num_fields; f++) {
+    if (fields & FIELD(f)) {
+      dial_dist(m, field_ctype[f], world.pc.pos, world.dist[f]);
+    }
+  }
+}
+
+/* Distances for ctype on m to the nearest of count sources, in one *
+ * traversal: every source is queued at distance zero and they all  *
+ * spread at once.  A source is at zero however it's reached, like  *
+ * the PC in its own field, but one ctype can't leave (or on the    *
+ * border) reaches nothing else.  If owner isn't NULL it gets, for  *
+ * each reachable cell, the index in sources of a nearest one, or   *
+ * PATHFIND_NO_OWNER.                                               */
+void pathfind_multi(Map *m, character_type_t ctype, const pair_t *sources,
+                    int count, pathfind_row_t *dist, uint8_t (*owner)[MAP_X])
+{
+  int16_t start[PATHFIND_MAX_SOURCES];
+  int16_t x, y;
+  int j;
+
+  assert(count <= PATHFIND_MAX_SOURCES);
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      dist[y][x] = PATHFIND_INF;
+      if (owner) {
+        owner[y][x] = PATHFIND_NO_OWNER;
+      }
+    }
+  }
+
+  for (j = 0; j < count; j++) {
+    start[j] = map_grid::index(sources[j][dim_x], sources[j][dim_y]);
+    dist[0][start[j]] = 0;
+    if (owner) {
+      owner[0][start[j]] = j;
+    }
+  }
+
+  dial_costs<map_grid>(m->map[0], ctype, dial_cost);
+  dial_kernel<map_grid>(dial_cost, dist[0], start, count,
+                        owner ? owner[0] : NULL);
+}
+
+/**************************************************************************
+ * Every field's search fused into one Dial traversal.  A queue entry is *
+ * a (cell, profile) pair, e = cell * FUSED_PROFILES + profile, so the   *
+ * searches share one bucket ring and advance through the distances     *
+ * together.  Each cell's costs and links for every profile sit side by  *
+ * side, the terrain is read once per cell for all of them, and the map  *
+ * border is folded into the cost table so that relaxing needs no bounds *
+ * checks: a neighbour is a fixed offset in the flattened map.           *
+ **************************************************************************/
+
+#define FUSED_PROFILES 4         /* Power of two, for e's divisions */
+#define FUSED_WALL     UINT8_MAX /* Impassable, or on the border */
+
+static_assert(FUSED_PROFILES >= PATHFIND_MAX_FIELDS,
+              "Every field needs a fused profile");
+
+static uint8_t fused_cost[map_grid::cells][FUSED_PROFILES];
+static int16_t fused_next[map_grid::cells * FUSED_PROFILES];
+static int16_t fused_prev[map_grid::cells * FUSED_PROFILES];
+static uint8_t fused_target[map_grid::cells];
+
+/* Why a search stopped */
+typedef enum bound {
+  bound_none,       /* It didn't; the map is complete */
+  bound_targets,    /* Every target was settled */
+  bound_radius      /* It reached the radius */
+} bound_t;
+
+/* Without the border walls, a border cell's neighbours may be off the map */
+static int fused_inner(const pair_t pos)
+{
+  return map_grid::inner(pos[dim_x], pos[dim_y]);
+}
+
+static void fused_costs(Map *m)
+{
+  int32_t w;
+  int16_t i, x, y;
+  int p;
+
+  for (y = 0, i = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++, i++) {
+      for (p = 0; p < num_fields; p++) {
+        w = ter_cost(x, y, field_ctype[p]);
+        if (!map_grid::inner(x, y) || w == INT_MAX) {
+          fused_cost[i][p] = FUSED_WALL;
+        } else {
+          assert(w < DIAL_BUCKETS);
+          fused_cost[i][p] = w;
+        }
+      }
+    }
+  }
+}
+
+/* dial_propagate for the profiles in fields at once, from an inner  *
+ * cell start.  fused_costs must be current for the map.             *
+ *                                                                    *
+ * The search can stop early, once targets cells marked in            *
+ * fused_target have been settled (for one profile only) or once it   *
+ * has gone further than radius.  Cells it had reached but not yet    *
+ * settled then go back to PATHFIND_INF, so every finite distance is  *
+ * still exact; cells that are PATHFIND_INF may just not have been    *
+ * explored.                                                          */
+static bound_t fused_propagate(int16_t start, unsigned fields,
+                               uint32_t targets, int32_t radius)
+{
+  static uint32_t initialized = 0;
+  uint16_t *dist[FUSED_PROFILES];
+  int16_t head[DIAL_BUCKETS];
+  int32_t cur, d;
+  uint32_t queued;
+  int16_t e, f, i, n;
+  bound_t bound;
+  int k, p;
+
+  if (!initialized) {
+    initialized = 1;
+    for (e = 0; e < map_grid::cells * FUSED_PROFILES; e++) {
+      fused_prev[e] = DIAL_OUT;
+    }
+  }
+
+  for (k = 0; k < DIAL_BUCKETS; k++) {
+    head[k] = DIAL_NONE;
+  }
+  /* Profiles past num_fields are never queued */
+  for (p = 0; p < FUSED_PROFILES; p++) {
+    dist[p] = p < num_fields ? world.dist[p][0] : NULL;
+  }
+
+  /* Every profile being computed has start at zero */
+  queued = 0;
+  for (p = 0; p < FUSED_PROFILES; p++) {
+    if ((fields & FIELD(p)) && fused_cost[start][p] != FUSED_WALL) {
+      e = start * FUSED_PROFILES + p;
+      fused_prev[e] = DIAL_NONE;
+      fused_next[e] = head[0];
+      if (fused_next[e] != DIAL_NONE) {
+        fused_prev[fused_next[e]] = e;
+      }
+      head[0] = e;
+      queued++;
+    }
+  }
+
+  assert(!targets || !(fields & (fields - 1)));
+
+  bound = bound_none;
+  for (cur = 0; queued && cur <= radius; cur++) {
+    while ((e = head[cur & (DIAL_BUCKETS - 1)]) != DIAL_NONE) {
+      head[cur & (DIAL_BUCKETS - 1)] = fused_next[e];
+      if (fused_next[e] != DIAL_NONE) {
+        fused_prev[fused_next[e]] = DIAL_NONE;
+      }
+      fused_prev[e] = DIAL_OUT;
+      queued--;
+
+      i = e / FUSED_PROFILES;
+      p = e % FUSED_PROFILES;
+      if (targets && fused_target[i] && !--targets) {
+        bound = bound_targets;
+        radius = cur; /* Ends the outer loop too */
+        break;
+      }
+      d = cur + fused_cost[i][p];
+
+      for (k = 0; k < 8; k++) {
+        n = i + map_grid::step[k];
+        if (fused_cost[n][p] == FUSED_WALL || dist[p][n] <= d) {
+          continue;
+        }
+        f = n * FUSED_PROFILES + p;
+
+        if (fused_prev[f] != DIAL_OUT) {
+          /* Already queued at a larger distance; unlink it */
+          if (fused_prev[f] != DIAL_NONE) {
+            fused_next[fused_prev[f]] = fused_next[f];
+          } else {
+            head[dist[p][n] & (DIAL_BUCKETS - 1)] = fused_next[f];
+          }
+          if (fused_next[f] != DIAL_NONE) {
+            fused_prev[fused_next[f]] = fused_prev[f];
+          }
+        } else {
+          queued++;
+        }
+
+        dist[p][n] = d;
+        fused_prev[f] = DIAL_NONE;
+        fused_next[f] = head[d & (DIAL_BUCKETS - 1)];
+        if (fused_next[f] != DIAL_NONE) {
+          fused_prev[fused_next[f]] = f;
+        }
+        head[d & (DIAL_BUCKETS - 1)] = f;
+      }
+    }
+  }
+
+  /* Stopped early; whatever is still queued has only an upper bound */
+  if (queued && bound == bound_none) {
+    bound = bound_radius;
+  }
+  for (k = 0; queued && k < DIAL_BUCKETS; k++) {
+    while ((e = head[k]) != DIAL_NONE) {
+      head[k] = fused_next[e];
+      fused_prev[e] = DIAL_OUT;
+      dist[e % FUSED_PROFILES][e / FUSED_PROFILES] = PATHFIND_INF;
+      queued--;
+    }
+  }
+
+  return bound;
+}
+
+static void fused_pathfind(Map *m, unsigned fields)
+{
+  int16_t x, y;
+  int f;
+
+  if (!fused_inner(world.pc.pos)) {
+    dial_pathfind(m, fields);
+    return;
+  }
+
+  for (f = 0; f < num_fields; f++) {
+    if (fields & FIELD(f)) {
+      for (y = 0; y < MAP_Y; y++) {
+        for (x = 0; x < MAP_X; x++) {
+          world.dist[f][y][x] = PATHFIND_INF;
+        }
+      }
+      world.dist[f][world.pc.pos[dim_y]][world.pc.pos[dim_x]] = 0;
+    }
+  }
+
+  fused_costs(m);
+  fused_propagate(world.pc.pos[dim_y] * MAP_X + world.pc.pos[dim_x], fields,
+                  0, INT_MAX);
+}
+
+/**************************************************************************
+ * Chamfer sweeps.  Instead of settling cells in distance order, sweep   *
+ * the whole map down and then up, lowering each row from the row        *
+ * before it and then along itself, and repeat until a round changes     *
+ * nothing; the fixed point is the same as Dijkstra's.  A row is 80      *
+ * 16-bit distances, ten SSE2 vectors, and the pass from the neighbouring *
+ * row is three unaligned loads, saturating adds and mins per vector.    *
+ * Each row is padded by a vector of CHAMFER_INF on either side, so the  *
+ * diagonal neighbours at the row ends need no special case.  Only the   *
+ * left and right scans along a row, which carry a dependence from cell  *
+ * to cell, are scalar.                                                  *
+ **************************************************************************/
+
+#if MAP_X % 8
+# error "Chamfer rows must be a whole number of SSE2 vectors"
+#endif
+
+#define CHAMFER_INF INT16_MAX
+#define CHAMFER_PAD 8
+#define CHAMFER_W   (MAP_X + 2 * CHAMFER_PAD)
+
+/* Distance, cost of leaving, and a floor that is 0 where a cell can be *
+ * reached and CHAMFER_INF where it can't, all padded with CHAMFER_INF. */
+alignas(16) static int16_t chamfer_d[MAP_Y][CHAMFER_W];
+alignas(16) static int16_t chamfer_c[MAP_Y][CHAMFER_W];
+alignas(16) static int16_t chamfer_b[MAP_Y][CHAMFER_W];
+
+/* Lowers row y from its three neighbours in row f */
+static int chamfer_row(int y, int f)
+{
+  int changed, x;
+
+#ifdef __SSE2__
+  __m128i t, l, r, old, d;
+  int i;
+
+  for (changed = 0, x = 0; x < MAP_X; x += 8) {
+    i = CHAMFER_PAD + x;
+    l = _mm_adds_epi16(_mm_loadu_si128((__m128i *) &chamfer_d[f][i - 1]),
+                       _mm_loadu_si128((__m128i *) &chamfer_c[f][i - 1]));
+    t = _mm_adds_epi16(_mm_load_si128((__m128i *) &chamfer_d[f][i]),
+                       _mm_load_si128((__m128i *) &chamfer_c[f][i]));
+    r = _mm_adds_epi16(_mm_loadu_si128((__m128i *) &chamfer_d[f][i + 1]),
+                       _mm_loadu_si128((__m128i *) &chamfer_c[f][i + 1]));
+    t = _mm_max_epi16(_mm_min_epi16(t, _mm_min_epi16(l, r)),
+                      _mm_load_si128((__m128i *) &chamfer_b[y][i]));
+    old = _mm_load_si128((__m128i *) &chamfer_d[y][i]);
+    d = _mm_min_epi16(old, t);
+    _mm_store_si128((__m128i *) &chamfer_d[y][i], d);
+    changed |= _mm_movemask_epi8(_mm_cmpeq_epi16(d, old)) != 0xffff;
+  }
+#else
+  int32_t t;
+  int k;
+
+  for (changed = 0, x = CHAMFER_PAD; x < CHAMFER_PAD + MAP_X; x++) {
+    if (chamfer_b[y][x]) {
+      continue;
+    }
+    for (k = -1; k <= 1; k++) {
+      t = chamfer_d[f][x + k] + chamfer_c[f][x + k];
+      if (t < chamfer_d[y][x]) {
+        chamfer_d[y][x] = t;
+        changed = 1;
+      }
+    }
+  }
+#endif
+
+  return changed;
+}
+
+/* Lowers row y along itself, left to right and then right to left */
+static int chamfer_scan(int y)
+{
+  int16_t *d = chamfer_d[y], *c = chamfer_c[y], *b = chamfer_b[y];
+  int32_t t;
+  int changed, x;
+
+  for (changed = 0, x = CHAMFER_PAD + 1; x < CHAMFER_PAD + MAP_X; x++) {
+    t = d[x - 1] + c[x - 1];
+    if (t < d[x] && !b[x]) {
+      d[x] = t;
+      changed = 1;
+    }
+  }
+  for (x = CHAMFER_PAD + MAP_X - 2; x >= CHAMFER_PAD; x--) {
+    t = d[x + 1] + c[x + 1];
+    if (t < d[x] && !b[x]) {
+      d[x] = t;
+      changed = 1;
+    }
+  }
+
+  return changed;
+}
+
+static void chamfer_dist(Map *m, character_type_t ctype,
+                         uint16_t dist[MAP_Y][MAP_X])
+{
+  int32_t w;
+  int changed, x, y;
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < CHAMFER_W; x++) {
+      chamfer_d[y][x] = chamfer_c[y][x] = chamfer_b[y][x] = CHAMFER_INF;
+    }
+    if (y < 1 || y > MAP_Y - 2) {
+      continue;
+    }
+    for (x = 1; x < MAP_X - 1; x++) {
+      if ((w = ter_cost(x, y, ctype)) != INT_MAX) {
+        chamfer_c[y][CHAMFER_PAD + x] = w;
+        chamfer_b[y][CHAMFER_PAD + x] = 0;
+      }
+    }
+  }
+  chamfer_d[world.pc.pos[dim_y]][CHAMFER_PAD + world.pc.pos[dim_x]] = 0;
+
+  do {
+    changed = 0;
+    for (y = 1; y < MAP_Y - 1; y++) {
+      changed |= chamfer_row(y, y - 1);
+      changed |= chamfer_scan(y);
+    }
+    for (y = MAP_Y - 2; y > 0; y--) {
+      changed |= chamfer_row(y, y + 1);
+      changed |= chamfer_scan(y);
+    }
+  } while (changed);
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      w = chamfer_d[y][CHAMFER_PAD + x];
+      if (w >= CHAMFER_INF - DIAL_BUCKETS && w != CHAMFER_INF) {
+        /* So close to saturating that a longer path may have; *
+         * 16 bits wasn't enough for this map.                 */
+        dial_dist(m, ctype, world.pc.pos, dist);
+        return;
+      }
+      dist[y][x] = w == CHAMFER_INF ? PATHFIND_INF : w;
+    }
+  }
+}
+
+static void chamfer_pathfind(Map *m, unsigned fields)
+{
+  int f;
+
+  if (!fused_inner(world.pc.pos)) {
+    dial_pathfind(m, fields);
+    return;
+  }
+
+  for (f = 0; f < num_fields; f++) {
+    if (fields & FIELD(f)) {
+      chamfer_dist(m, field_ctype[f], world.dist[f]);
+    }
+  }
+}
+
+/**************************************************************************
+ * Incremental repair.  When the PC steps from s to a neighbouring s',   *
+ * every old distance d(v) gives an upper bound d(v) + cost(s') on the   *
+ * new one (step back to s, then follow the old path), and those bounds  *
+ * are consistent with each other.  So it's enough to put s' at zero and *
+ * propagate improvements from there; cells whose best route still runs *
+ * back through s are never touched.  The result is exactly what a full *
+ * recompute gives, which pathfind_set_verify checks after every repair. *
+ **************************************************************************/
+
+/* What each distance map holds */
+static struct {
+  Map *map;         /* NULL when the distance map isn't pathfind()'s */
+  uint32_t version;
+  pair_t pos;
+  bound_t bound;    /* Only explored around the pursuers; see bounded() */
+} held[PATHFIND_MAX_FIELDS];
+
+static int verify = 0;
+static pathfind_stats_t stats;
+
+static int can_repair(Map *m, int f)
+{
+  /* A partial map's PATHFIND_INFs aren't upper bounds that agree with *
+   * their neighbours, so repairing one wouldn't explore past them.  */
+  return (held[f].map == m && held[f].version == m->terrain_version &&
+          held[f].bound == bound_none &&
+          abs(world.pc.pos[dim_x] - held[f].pos[dim_x]) <= 1 &&
+          abs(world.pc.pos[dim_y] - held[f].pos[dim_y]) <= 1 &&
+          (world.pc.pos[dim_x] != held[f].pos[dim_x] ||
+           world.pc.pos[dim_y] != held[f].pos[dim_y]) &&
+          ter_cost(held[f].pos[dim_x], held[f].pos[dim_y],
+                   field_ctype[f]) != INT_MAX &&
+          ter_cost(world.pc.pos[dim_x], world.pc.pos[dim_y],
+                   field_ctype[f]) != INT_MAX);
+}
+
+static void repair_dist(Map *m, int f)
+{
+  int32_t c;
+  int16_t x, y;
+
+  c = ter_cost(world.pc.pos[dim_x], world.pc.pos[dim_y], field_ctype[f]);
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      if (world.dist[f][y][x] != PATHFIND_INF) {
+        world.dist[f][y][x] = (world.dist[f][y][x] + c < PATHFIND_INF ?
+                               world.dist[f][y][x] + c : PATHFIND_INF);
+      }
+    }
+  }
+  world.dist[f][world.pc.pos[dim_y]][world.pc.pos[dim_x]] = 0;
+}
+
+static void repair(Map *m, unsigned fields)
+{
+  int16_t start;
+  int f;
+
+  for (f = 0; f < num_fields; f++) {
+    if (fields & FIELD(f)) {
+      repair_dist(m, f);
+    }
+  }
+
+  start = world.pc.pos[dim_y] * MAP_X + world.pc.pos[dim_x];
+  if (fused_inner(world.pc.pos)) {
+    fused_costs(m);
+    fused_propagate(start, fields, 0, INT_MAX);
+  } else {
+    for (f = 0; f < num_fields; f++) {
+      if (fields & FIELD(f)) {
+        dial_propagate(m, field_ctype[f], world.dist[f], start);
+      }
+    }
+  }
+}
+
+static void compute(Map *m, pathfind_engine_t e, unsigned fields)
+{
+  switch (e) {
+  case pathfind_fibonacci:
+    fibonacci_pathfind(m, fields);
+    break;
+  case pathfind_intrusive:
+    intrusive_pathfind(m, fields);
+    break;
+  case pathfind_fused:
+    fused_pathfind(m, fields);
+    break;
+  case pathfind_chamfer:
+    chamfer_pathfind(m, fields);
+    break;
+  case pathfind_dial:
+  default:
+    dial_pathfind(m, fields);
+    break;
+  }
+}
+
+static void verify_dist(Map *m, int f, const char *how)
+{
+  static uint16_t dist[MAP_Y][MAP_X];
+
+  memcpy(dist, world.dist[f], sizeof (dist));
+  compute(m, engine, FIELD(f));
+  stats.verified++;
+
+  if (memcmp(dist, world.dist[f], sizeof (dist))) {
+    fprintf(stderr, "%s %s distances at (%d,%d) disagree with %s\n",
+            how, char_type_name[field_ctype[f]],
+            world.pc.pos[dim_x], world.pc.pos[dim_y],
+            pathfind_engine_name[engine]);
+    abort();
+  }
+}
+
+/* A partial map must agree with a full one wherever it's finite */
+static void verify_partial(Map *m, int f)
+{
+  static uint16_t dist[MAP_Y][MAP_X];
+  int x, y;
+
+  memcpy(dist, world.dist[f], sizeof (dist));
+  compute(m, engine, FIELD(f));
+  stats.verified++;
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      if (dist[y][x] != PATHFIND_INF && dist[y][x] != world.dist[f][y][x]) {
+        fprintf(stderr, "Bounded %s distance at (%d,%d) from (%d,%d) "
+                        "disagrees with %s\n",
+                char_type_name[field_ctype[f]], x, y,
+                world.pc.pos[dim_x], world.pc.pos[dim_y],
+                pathfind_engine_name[engine]);
+        abort();
+      }
+    }
+  }
+
+  memcpy(world.dist[f], dist, sizeof (dist));
+}
+
+/**************************************************************************
+ * Distance-map cache.  A PC pacing back and forth asks for the same     *
+ * maps over and over, so the last few results are kept, keyed by which  *
+ * map they are, terrain version and PC position, and evicted least      *
+ * recently used.  Terrain versions are never reused (see                *
+ * map_terrain_changed()), so a terrain change makes every entry for the *
+ * old terrain unreachable without anyone having to flush it.  Entries   *
+ * are copies of the 16-bit fields.                                      *
+ **************************************************************************/
+
+typedef struct cache_entry {
+  Map *map;
+  uint32_t version;
+  pair_t pos;
+  int field;
+  uint32_t used;    /* Clock at last use; 0 if the entry is empty */
+  int speculative;  /* Stored by speculate() and not yet loaded */
+  uint16_t dist[MAP_Y][MAP_X];
+} cache_entry_t;
+
+static cache_entry_t cache[PATHFIND_CACHE_SIZE];
+static uint32_t cache_clock;
+static int cache_enabled = 1;
+
+static cache_entry_t *cache_find(Map *m, int f, const pair_t pos)
+{
+  int i;
+
+  for (i = 0; i < PATHFIND_CACHE_SIZE; i++) {
+    if (cache[i].used && cache[i].map == m && cache[i].field == f &&
+        cache[i].version == m->terrain_version &&
+        cache[i].pos[dim_x] == pos[dim_x] &&
+        cache[i].pos[dim_y] == pos[dim_y]) {
+      return cache + i;
+    }
+  }
+
+  return NULL;
+}
+
+static int cache_load(Map *m, int f)
+{
+  cache_entry_t *c;
+
+  if (!(c = cache_find(m, f, world.pc.pos))) {
+    return 0;
+  }
+
+  if (c->speculative) {
+    c->speculative = 0;
+    stats.foreseen++;
+  }
+  c->used = ++cache_clock;
+  memcpy(world.dist[f], c->dist, sizeof (c->dist));
+
+  return 1;
+}
+
+/* Keeps dist as field f's map for a PC at pos */
+static cache_entry_t *cache_store(Map *m, int f, const pair_t pos,
+                                  uint16_t dist[MAP_Y][MAP_X])
+{
+  cache_entry_t *c;
+  int i;
+
+  /* Empty entries have used == 0, so they go first */
+  for (c = cache, i = 1; i < PATHFIND_CACHE_SIZE; i++) {
+    if (cache[i].used < c->used) {
+      c = cache + i;
+    }
+  }
+
+  memcpy(c->dist, dist, sizeof (c->dist));
+  c->map = m;
+  c->version = m->terrain_version;
+  c->pos[dim_x] = pos[dim_x];
+  c->pos[dim_y] = pos[dim_y];
+  c->field = f;
+  c->used = ++cache_clock;
+  c->speculative = 0;
+
+  return c;
+}
+
+/**************************************************************************
+ * Early termination.  A hiker or rival only looks at the distances of   *
+ * the cells around it, so when one of them asks, the search can stop    *
+ * as soon as every pursuer of that kind has its own cell and its eight  *
+ * neighbours settled, or once it's further out than the radius set by   *
+ * pathfind_set_radius().  Pursuers close to the PC then cost a small    *
+ * disc instead of the whole map.  Anything not settled is PATHFIND_INF, *
+ * which the movers already treat as somewhere not to go.                *
+ **************************************************************************/
+
+static int early_exit = 1;
+static int32_t radius = 0;
+
+/* Whether every cell a pursuer at pos reads has been settled.  A cell *
+ * next to a reachable one is reachable too, so a PATHFIND_INF it can  *
+ * enter just hasn't been explored yet.                                */
+static int covered(Map *m, int f, const pair_t pos)
+{
+  int x, y;
+
+  for (y = pos[dim_y] - 1; y <= pos[dim_y] + 1; y++) {
+    for (x = pos[dim_x] - 1; x <= pos[dim_x] + 1; x++) {
+      if (y >= 1 && y <= MAP_Y - 2 && x >= 1 && x <= MAP_X - 2 &&
+          ter_cost(x, y, field_ctype[f]) != INT_MAX &&
+          world.dist[f][y][x] == PATHFIND_INF) {
+        return 0;
+      }
+    }
+  }
+
+  return 1;
+}
+
+static bound_t bounded(Map *m, int f)
+{
+  uint32_t targets;
+  int16_t i;
+  int x, y, dx, dy;
+  Npc *n;
+
+  if (!fused_inner(world.pc.pos)) {
+    compute(m, engine, FIELD(f));
+    return bound_none;
+  }
+
+  memset(fused_target, 0, sizeof (fused_target));
+  fused_costs(m);
+
+  for (targets = 0, y = 1; early_exit && y < MAP_Y - 1; y++) {
+    for (x = 1; x < MAP_X - 1; x++) {
+      if (!(n = dynamic_cast<Npc *>(m->cmap[y][x])) ||
+          (n->mtype != move_hiker && n->mtype != move_rival) ||
+          type_field[n->ctype] != f) {
+        continue;
+      }
+      for (dy = -1; dy <= 1; dy++) {
+        for (dx = -1; dx <= 1; dx++) {
+          i = (y + dy) * MAP_X + x + dx;
+          if (fused_cost[i][f] != FUSED_WALL && !fused_target[i]) {
+            fused_target[i] = 1;
+            targets++;
+          }
+        }
+      }
+    }
+  }
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      world.dist[f][y][x] = PATHFIND_INF;
+    }
+  }
+  world.dist[f][world.pc.pos[dim_y]][world.pc.pos[dim_x]] = 0;
+
+  return fused_propagate(world.pc.pos[dim_y] * MAP_X + world.pc.pos[dim_x],
+                         FIELD(f), targets, radius ? radius : INT_MAX);
+}
+
+/**************************************************************************
+ * Next-hop tables.  Alongside each field, one byte per cell whose bit k *
+ * is set when all_dirs[k] leads to a neighbour with the least distance  *
+ * of any, so that a pursuer's turn is a lookup instead of eight probes  *
+ * and a call to rand().  A table is built from its field in one pass    *
+ * the first time it's read after the field changes, so it only pays     *
+ * for itself once a few pursuers read it; with SSE2, eight cells go at  *
+ * a time, taking the minimum of their eight neighbours and then         *
+ * comparing each neighbour against it.  Border cells, and cells the     *
+ * field's types can't stand on, hold whatever the pass left there.      *
+ **************************************************************************/
+
+static uint8_t hop[PATHFIND_MAX_FIELDS][map_grid::cells];
+static unsigned hop_stale = ~0U; /* Fields changed since their pass */
+
+template <class G>
+static uint8_t hop_cell(const uint16_t *dist, int16_t i)
+{
+  uint16_t best, d;
+  uint8_t hops;
+  int k;
+
+  for (best = PATHFIND_INF, hops = 0, k = 0; k < 8; k++) {
+    if ((d = dist[i + G::step[k]]) < best) {
+      best = d;
+      hops = 1U << k;
+    } else if (d == best && d != PATHFIND_INF) {
+      hops |= 1U << k;
+    }
+  }
+
+  return hops;
+}
+
+/* SSE2 has no unsigned 16-bit minimum, so the distances are biased *
+ * into signed ones, which order the same way, for the minimum.      */
+template <class G>
+static void hop_kernel(const uint16_t *dist, uint8_t *hops)
+{
+  int16_t x, y, i;
+  int k;
+#ifdef __SSE2__
+  const __m128i bias = _mm_set1_epi16(INT16_MIN);
+  __m128i n[8], best, h;
+#endif
+
+  for (y = 1; y < G::height - 1; y++) {
+    x = 1;
+#ifdef __SSE2__
+    for (; x + 8 <= G::width - 1; x += 8) {
+      i = G::index(x, y);
+      for (k = 0; k < 8; k++) {
+        n[k] = _mm_xor_si128(_mm_loadu_si128((__m128i *) (dist + i +
+                                                          G::step[k])),
+                             bias);
+      }
+      for (best = n[0], k = 1; k < 8; k++) {
+        best = _mm_min_epi16(best, n[k]);
+      }
+      for (h = _mm_setzero_si128(), k = 0; k < 8; k++) {
+        h = _mm_or_si128(h, _mm_and_si128(_mm_cmpeq_epi16(n[k], best),
+                                          _mm_set1_epi16(1 << k)));
+      }
+      h = _mm_andnot_si128(_mm_cmpeq_epi16(best,
+                                           _mm_set1_epi16(INT16_MAX)), h);
+      _mm_storel_epi64((__m128i *) &hops[i], _mm_packus_epi16(h, h));
+    }
+#endif
+    for (; x < G::width - 1; x++) {
+      i = G::index(x, y);
+      hops[i] = hop_cell<G>(dist, i);
+    }
+  }
+}
+
+static void hop_pass(int f)
+{
+  hop_kernel<map_grid>(world.dist[f][0], hop[f]);
+}
+
+/* Which of all_dirs lead fastest downhill from pos, in the field    *
+ * pathfind_need() or pathfind_need_near() last brought up to date   *
+ * for ctype; 0 if none of pos's neighbours has been reached.        */
+uint8_t pathfind_next_hops(character_type_t ctype, const pair_t pos)
+{
+  int f;
+
+  f = pathfind_field(ctype);
+  if (hop_stale & FIELD(f)) {
+    hop_stale &= ~FIELD(f);
+    hop_pass(f);
+  }
+
+  return hop[f][pos[dim_y] * MAP_X + pos[dim_x]];
+}
+
+/**************************************************************************
+ * Speculation.  While the game sits in getch() waiting for the player, *
+ * a worker thread computes every field for each cell the PC could step *
+ * to and leaves them in the cache, so that after the keypress the maps *
+ * for wherever the PC went are a cache hit instead of a search.  The    *
+ * worker has the engines' statics, the cache and the world to itself:  *
+ * the main thread stops it before doing anything else, waiting at most *
+ * for the map it's in the middle of.                                    *
+ **************************************************************************/
+
+static int speculation = 1;
+static pthread_t spec_thread;
+static int spec_running;
+static int spec_cancel; /* Set by the main thread, polled by the worker */
+static Map *spec_map;
+static pair_t spec_from;
+
+static void *speculate(void *unused)
+{
+  static uint16_t dist[MAP_Y][MAP_X];
+  Map *m = spec_map;
+  pair_t to;
+  int f, k;
+
+  for (k = 0; k < 8; k++) {
+    to[dim_x] = spec_from[dim_x] + all_dirs[k][dim_x];
+    to[dim_y] = spec_from[dim_y] + all_dirs[k][dim_y];
+    /* Exits lead to another map, and a character there means a battle */
+    if (!fused_inner(to) || m->cmap[to[dim_y]][to[dim_x]] ||
+        move_cost[char_pc][m->map[to[dim_y]][to[dim_x]]] == INT_MAX) {
+      continue;
+    }
+    for (f = 0; f < num_fields; f++) {
+      if (__atomic_load_n(&spec_cancel, __ATOMIC_RELAXED)) {
+        return NULL;
+      }
+      if (!cache_find(m, f, to)) {
+        dial_dist(m, field_ctype[f], to, dist);
+        cache_store(m, f, to, dist)->speculative = 1;
+        stats.speculated++;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/* Starts computing, in the background, the maps for the PC's next   *
+ * move on m.  Nothing else may touch pathfinding, the map or the     *
+ * characters until pathfind_speculate_stop() or _wait().             */
+void pathfind_speculate(Map *m)
+{
+  if (!speculation || !cache_enabled || spec_running) {
+    return;
+  }
+
+  profiles();
+  spec_map = m;
+  spec_from[dim_x] = world.pc.pos[dim_x];
+  spec_from[dim_y] = world.pc.pos[dim_y];
+  spec_cancel = 0;
+  /* If there's no thread to be had, it's just a cache miss later */
+  spec_running = !pthread_create(&spec_thread, NULL, speculate, NULL);
+}
+
+static void speculate_join(int cancel)
+{
+  if (!spec_running) {
+    return;
+  }
+
+  if (cancel) {
+    __atomic_store_n(&spec_cancel, 1, __ATOMIC_RELAXED);
+  }
+  pthread_join(spec_thread, NULL);
+  spec_running = 0;
+}
+
+/* The key's been pressed; whatever's done is in the cache */
+void pathfind_speculate_stop(void)
+{
+  speculate_join(1);
+}
+
+/* Lets the worker finish, as a player slower than it would */
+void pathfind_speculate_wait(void)
+{
+  speculate_join(0);
+}
+
+/**************************************************************************
+ * Demand.  pathfind() only notes that the PC has moved; a distance map  *
+ * is brought up to date the first time someone calls pathfind_need()   *
+ * for it.  On a map whose hikers and rivals have all been beaten, and   *
+ * so wander instead of giving chase, nobody does, and a PC move costs  *
+ * nothing.  A map that was wanted but never needed before the next     *
+ * move counts as avoided.  A pathfind() with the PC where it was and   *
+ * the terrain as it was, like the one game_loop() makes right after    *
+ * new_map() made its own, changes nothing and is skipped.  Every PC   *
+ * move is followed by a pathfind(), so a field that isn't pending was  *
+ * computed for where the PC is now.                                    *
+ **************************************************************************/
+
+static Map *wanted;     /* Where pathfind() was last told the PC is */
+static pair_t wanted_pos;
+static uint32_t wanted_version;
+static unsigned pending; /* Fields wanted there and not yet computed */
+
+/* near: only the pursuers will read it, so bounded() will do */
+static void update(Map *m, int f, int near)
+{
+  bound_t bound;
+
+  bound = bound_none;
+  if (cache_enabled && cache_load(m, f)) {
+    stats.cached++;
+    if (verify) {
+      verify_dist(m, f, "Cached");
+    }
+  } else if (can_repair(m, f)) {
+    repair(m, FIELD(f));
+    stats.repaired++;
+    if (verify) {
+      verify_dist(m, f, "Repaired");
+    }
+    if (cache_enabled) {
+      cache_store(m, f, world.pc.pos, world.dist[f]);
+    }
+  } else if (near && (early_exit || radius)) {
+    bound = bounded(m, f);
+    stats.bounded++;
+    if (verify) {
+      verify_partial(m, f);
+    }
+  } else {
+    compute(m, engine, FIELD(f));
+    stats.full++;
+    if (cache_enabled) {
+      cache_store(m, f, world.pc.pos, world.dist[f]);
+    }
+  }
+
+  hop_stale |= FIELD(f);
+  held[f].map = m;
+  held[f].bound = bound;
+  held[f].version = m->terrain_version;
+  held[f].pos[dim_x] = world.pc.pos[dim_x];
+  held[f].pos[dim_y] = world.pc.pos[dim_y];
+}
+
+/* Every map, right now, bypassing the cache, repair and demand */
+void pathfind_with(Map *m, pathfind_engine_t e)
+{
+  profiles();
+  pathfind_invalidate();
+  compute(m, e, ALL_FIELDS);
+  hop_stale = ~0U;
+}
+
+void pathfind(Map *m)
+{
+  int f;
+
+  profiles();
+  if (wanted == m && wanted_version == m->terrain_version &&
+      wanted_pos[dim_x] == world.pc.pos[dim_x] &&
+      wanted_pos[dim_y] == world.pc.pos[dim_y]) {
+    stats.skipped++;
+    return;
+  }
+
+  for (f = 0; f < num_fields; f++) {
+    if (pending & FIELD(f)) {
+      stats.avoided++;
+    }
+  }
+
+  wanted = m;
+  wanted_version = m->terrain_version;
+  wanted_pos[dim_x] = world.pc.pos[dim_x];
+  wanted_pos[dim_y] = world.pc.pos[dim_y];
+  pending = ALL_FIELDS;
+}
+
+/* Whatever a field was brought up to date by, it has to be rooted at *
+ * the PC as it is now, not where it was when pathfind() last ran.    */
+static void verify_root(int f)
+{
+  if (world.dist[f][world.pc.pos[dim_y]][world.pc.pos[dim_x]]) {
+    fprintf(stderr, "%s distance at the PC's cell (%d,%d) is %d\n",
+            char_type_name[field_ctype[f]],
+            world.pc.pos[dim_x], world.pc.pos[dim_y],
+            world.dist[f][world.pc.pos[dim_y]][world.pc.pos[dim_x]]);
+    abort();
+  }
+}
+
+/* Whether field f was computed for another map, terrain or PC cell; *
+ * never, unless the PC moved without a pathfind() to say so.         */
+static int held_stale(int f)
+{
+  return (held[f].map != wanted ||
+          held[f].version != wanted->terrain_version ||
+          held[f].pos[dim_x] != world.pc.pos[dim_x] ||
+          held[f].pos[dim_y] != world.pc.pos[dim_y]);
+}
+
+/* Call before reading pathfind_dist(ctype) */
+void pathfind_need(character_type_t ctype)
+{
+  int f;
+
+  f = pathfind_field(ctype);
+  assert(!wanted || (pending & FIELD(f)) || !held_stale(f));
+  if ((pending & FIELD(f)) || (wanted && held[f].bound != bound_none)) {
+    pending &= ~FIELD(f);
+    update(wanted, f, 0);
+  }
+  if (verify && wanted) {
+    verify_root(f);
+  }
+}
+
+/* pathfind_need() for a pursuer at pos that only reads the distances *
+ * of its own cell and the cells around it.                           */
+void pathfind_need_near(character_type_t ctype, const pair_t pos)
+{
+  int f;
+
+  f = pathfind_field(ctype);
+  assert(!wanted || (pending & FIELD(f)) || !held_stale(f));
+  /* Once the radius is reached, exploring again won't get any further */
+  if ((pending & FIELD(f)) ||
+      (wanted && held[f].bound == bound_targets &&
+       !covered(wanted, f, pos))) {
+    pending &= ~FIELD(f);
+    update(wanted, f, 1);
+  }
+  if (verify && wanted) {
+    verify_root(f);
+  }
+}
+
+/**************************************************************************
+ * Point-to-point queries.  Walking to the mart or to an exit needs one  *
+ * route, not a distance map, so path_query() runs A* from one cell to   *
+ * another.  Every step costs at least the cheapest terrain ctype can    *
+ * enter, and diagonal steps cost the same as straight ones, so the      *
+ * octile distance collapses to the larger of dx and dy; scaled by that  *
+ * cheapest cost it never overestimates.  Landmarks (below) tighten it.  *
+ * The estimate is consistent, so no cell is settled twice, and a step   *
+ * raises the priority (cost plus estimate) by at most the costs of the  *
+ * two cells involved, which keeps the queue within a Dial bucket ring.  *
+ * Cells carry the number of the query that last touched them instead   *
+ * of being reset, so a short route only costs the cells it explores.    *
+ **************************************************************************/
+
+#define ASTAR_BUCKETS 128 /* Power of two greater than two move costs */
+
+typedef struct astar {
+  uint32_t seen;    /* Query that set cost, f and from */
+  uint32_t settled; /* Query that settled it */
+  int32_t cost;     /* From the start, paying for each cell entered */
+  int32_t f;        /* cost plus the estimate */
+  int16_t from;     /* Previous cell on the best route, flattened */
+  int16_t next;     /* Links in f's bucket while queued */
+  int16_t prev;
+} astar_t;
+
+static astar_t astar[MAP_Y * MAP_X];
+static uint32_t astar_query;
+
+/**************************************************************************
+ * ALT landmarks.  For a few landmark cells per map and profile, keep    *
+ * the cost of reaching the landmark from every cell, which is exactly   *
+ * the Dial distance map out from the landmark: a route's cells entered  *
+ * going in are the cells left coming out.  The triangle inequality then *
+ * bounds the cost of any route u to t from below by                     *
+ *                                                                        *
+ *   to(u) - to(t)                        via the landmark after t, and   *
+ *   to(t) + cost(t) - to(u) - cost(u)    via it before u,                *
+ *                                                                        *
+ * the second because a route's reverse costs it cost(t) - cost(u) more. *
+ * Both bounds are consistent, as is their maximum with the octile one.  *
+ * Landmarks are picked farthest first, starting from the passable cell  *
+ * nearest a corner, and the tables are built the first time a profile   *
+ * is queried on a terrain version, then kept, 16 bits a distance, until *
+ * the map goes.  A landmark with a distance too big for 16 bits is      *
+ * dropped.  Reachability is symmetric, so a route between a cell that   *
+ * reaches a landmark and one that doesn't can be ruled out unsearched.  *
+ **************************************************************************/
+
+#define PATH_LANDMARKS 4
+#define LANDMARK_INF   PATHFIND_INF
+
+struct path_landmarks {
+  uint32_t version; /* The map's terrain_version when built */
+  int count;
+  uint16_t to[PATH_LANDMARKS][MAP_Y][MAP_X];
+};
+
+static int landmarks_enabled = 1;
+
+static void landmarks_build(Map *m, character_type_t ctype,
+                            path_landmarks *lm)
+{
+  uint16_t (*dist)[MAP_X];
+  int32_t best, d;
+  int16_t x, y, l, k, pick;
+
+  lm->version = m->terrain_version;
+  lm->count = 0;
+  stats.landmarks++;
+
+  /* The passable cell nearest the top left corner to start with */
+  for (pick = -1, best = INT_MAX, y = 1; y < MAP_Y - 1; y++) {
+    for (x = 1; x < MAP_X - 1; x++) {
+      if (ter_cost(x, y, ctype) != INT_MAX && (x > y ? x : y) < best) {
+        best = x > y ? x : y;
+        pick = y * MAP_X + x;
+      }
+    }
+  }
+
+  for (l = 0; pick != -1 && l < PATH_LANDMARKS; l++) {
+    dist = lm->to[lm->count];
+    for (y = 0; y < MAP_Y; y++) {
+      for (x = 0; x < MAP_X; x++) {
+        dist[y][x] = LANDMARK_INF;
+      }
+    }
+    dist[pick / MAP_X][pick % MAP_X] = 0;
+    if (!dial_propagate(m, ctype, dist, pick)) {
+      lm->count++;
+    }
+
+    /* Next, the cell furthest from every landmark so far */
+    for (pick = -1, best = 0, y = 1; lm->count && y < MAP_Y - 1; y++) {
+      for (x = 1; x < MAP_X - 1; x++) {
+        if (lm->to[0][y][x] == LANDMARK_INF) {
+          continue;
+        }
+        for (d = INT_MAX, k = 0; k < lm->count; k++) {
+          if (lm->to[k][y][x] < d) {
+            d = lm->to[k][y][x];
+          }
+        }
+        if (d > best) {
+          best = d;
+          pick = y * MAP_X + x;
+        }
+      }
+    }
+  }
+}
+
+static path_landmarks *landmarks(Map *m, character_type_t ctype)
+{
+  if (!landmarks_enabled) {
+    return NULL;
+  }
+  if (!m->landmarks[ctype]) {
+    m->landmarks[ctype] = (path_landmarks *) malloc(sizeof (path_landmarks));
+    landmarks_build(m, ctype, m->landmarks[ctype]);
+  } else if (m->landmarks[ctype]->version != m->terrain_version) {
+    landmarks_build(m, ctype, m->landmarks[ctype]);
+  }
+
+  return m->landmarks[ctype]->count ? m->landmarks[ctype] : NULL;
+}
+
+/* What an estimate needs to know about the goal */
+typedef struct astar_goal {
+  Map *m;
+  character_type_t ctype;
+  pair_t to;
+  int32_t step;              /* The cheapest cell ctype can enter */
+  const path_landmarks *lm;  /* NULL for octile only */
+  int32_t to_goal[PATH_LANDMARKS];
+  int32_t goal_cost;
+} astar_goal_t;
+
+/* The cheapest cell ctype can enter */
+static int32_t astar_step(character_type_t ctype)
+{
+  int32_t step;
+  int t;
+
+  for (step = INT_MAX, t = 0; t < num_terrain_types; t++) {
+    if (move_cost[ctype][t] < step) {
+      step = move_cost[ctype][t];
+    }
+  }
+
+  return step;
+}
+
+/* Returns nonzero if no route can reach to from from */
+static int astar_aim(astar_goal_t *g, Map *m, const pair_t from,
+                     const pair_t to, character_type_t ctype)
+{
+  int l;
+
+  g->m = m;
+  g->ctype = ctype;
+  g->to[dim_x] = to[dim_x];
+  g->to[dim_y] = to[dim_y];
+  g->step = astar_step(ctype);
+  g->goal_cost = ter_cost(to[dim_x], to[dim_y], ctype);
+
+  if ((g->lm = landmarks(m, ctype))) {
+    for (l = 0; l < g->lm->count; l++) {
+      g->to_goal[l] = g->lm->to[l][to[dim_y]][to[dim_x]];
+    }
+    /* An impassable start is left, never entered, so it reaches nothing */
+    if (ter_cost(from[dim_x], from[dim_y], ctype) != INT_MAX &&
+        ((g->lm->to[0][from[dim_y]][from[dim_x]] == LANDMARK_INF) !=
+         (g->to_goal[0] == LANDMARK_INF))) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static int32_t astar_h(const astar_goal_t *g, int x, int y)
+{
+  Map *m;
+  int32_t h, b, to;
+  int dx, dy, l;
+
+  dx = abs(g->to[dim_x] - x);
+  dy = abs(g->to[dim_y] - y);
+  h = (dx > dy ? dx : dy) * g->step;
+
+  /* Every landmark is in the first one's component, so if either cell *
+   * can't reach the first, neither bound has anything to say.          */
+  if (g->lm && g->to_goal[0] != LANDMARK_INF &&
+      g->lm->to[0][y][x] != LANDMARK_INF) {
+    m = g->m;
+    for (l = 0; l < g->lm->count; l++) {
+      to = g->lm->to[l][y][x];
+      if ((b = to - g->to_goal[l]) > h) {
+        h = b;
+      }
+      if ((b = g->to_goal[l] + g->goal_cost -
+           to - ter_cost(x, y, g->ctype)) > h) {
+        h = b;
+      }
+    }
+  }
+
+  return h;
+}
+
+static void astar_link(int16_t head[ASTAR_BUCKETS], int16_t i)
+{
+  astar[i].prev = DIAL_NONE;
+  astar[i].next = head[astar[i].f & (ASTAR_BUCKETS - 1)];
+  if (astar[i].next != DIAL_NONE) {
+    astar[astar[i].next].prev = i;
+  }
+  head[astar[i].f & (ASTAR_BUCKETS - 1)] = i;
+}
+
+static void astar_unlink(int16_t head[ASTAR_BUCKETS], int16_t i)
+{
+  if (astar[i].prev != DIAL_NONE) {
+    astar[astar[i].prev].next = astar[i].next;
+  } else {
+    head[astar[i].f & (ASTAR_BUCKETS - 1)] = astar[i].next;
+  }
+  if (astar[i].next != DIAL_NONE) {
+    astar[astar[i].next].prev = astar[i].prev;
+  }
+}
+
+/* Fills route, if not NULL, with the steps from the cell after from *
+ * up to and including to, and returns the cost of taking them: the  *
+ * sum of the move costs of the cells entered, which is what the game *
+ * charges.  INT_MAX if there is no route through the inner cells.    *
+ * Characters are ignored, since they'll have moved by the time the   *
+ * route gets walked.                                                  */
+int32_t path_query(Map *m, const pair_t from, const pair_t to,
+                   character_type_t ctype, path_route_t *route)
+{
+  int16_t head[ASTAR_BUCKETS];
+  int16_t i, n, goal, x, y, nx, ny;
+  astar_goal_t g;
+  int32_t cur, d;
+  uint32_t queued;
+  int k;
+
+  if (route) {
+    route->cost = INT_MAX;
+    route->len = 0;
+  }
+  stats.queries++;
+
+  if (!fused_inner(from) || !fused_inner(to) ||
+      ter_cost(to[dim_x], to[dim_y], ctype) == INT_MAX ||
+      astar_aim(&g, m, from, to, ctype)) {
+    return INT_MAX;
+  }
+
+  if (!++astar_query) {
+    /* Wrapped; forget every stamp so none look current */
+    memset(astar, 0, sizeof (astar));
+    astar_query = 1;
+  }
+
+  for (k = 0; k < ASTAR_BUCKETS; k++) {
+    head[k] = DIAL_NONE;
+  }
+
+  goal = to[dim_y] * MAP_X + to[dim_x];
+  i = from[dim_y] * MAP_X + from[dim_x];
+  astar[i].seen = astar_query;
+  astar[i].cost = 0;
+  astar[i].f = cur = astar_h(&g, from[dim_x], from[dim_y]);
+  astar[i].from = DIAL_NONE;
+  astar_link(head, i);
+  queued = 1;
+
+  for (; queued && astar[goal].settled != astar_query; cur++) {
+    while ((i = head[cur & (ASTAR_BUCKETS - 1)]) != DIAL_NONE) {
+      astar_unlink(head, i);
+      queued--;
+      astar[i].settled = astar_query;
+      stats.expanded++;
+      if (i == goal) {
+        break;
+      }
+
+      y = i / MAP_X;
+      x = i % MAP_X;
+      for (k = 0; k < 8; k++) {
+        nx = x + all_dirs[k][dim_x];
+        ny = y + all_dirs[k][dim_y];
+        if (ny < 1 || ny > MAP_Y - 2 || nx < 1 || nx > MAP_X - 2 ||
+            ter_cost(nx, ny, ctype) == INT_MAX) {
+          continue;
+        }
+        n = ny * MAP_X + nx;
+        d = astar[i].cost + ter_cost(nx, ny, ctype);
+        if (astar[n].settled == astar_query ||
+            (astar[n].seen == astar_query && astar[n].cost <= d)) {
+          continue;
+        }
+        if (astar[n].seen == astar_query) {
+          astar_unlink(head, n);
+        } else {
+          astar[n].seen = astar_query;
+          queued++;
+        }
+        astar[n].cost = d;
+        astar[n].f = d + astar_h(&g, nx, ny);
+        assert(astar[n].f - cur < ASTAR_BUCKETS);
+        astar[n].from = i;
+        astar_link(head, n);
+      }
+    }
+  }
+
+  if (astar[goal].settled != astar_query) {
+    return INT_MAX;
+  }
+
+  if (route) {
+    route->cost = astar[goal].cost;
+    for (i = goal; astar[i].from != DIAL_NONE; i = astar[i].from) {
+      route->len++;
+    }
+    for (k = route->len - 1, i = goal; k >= 0; k--, i = astar[i].from) {
+      route->step[k][dim_x] = i % MAP_X;
+      route->step[k][dim_y] = i / MAP_X;
+    }
+  }
+
+  return astar[goal].cost;
+}
+
+/* Never more than path_query() would return, without searching */
+int32_t path_estimate(Map *m, const pair_t from, const pair_t to,
+                      character_type_t ctype)
+{
+  astar_goal_t g;
+
+  if (astar_aim(&g, m, from, to, ctype)) {
+    return INT_MAX;
+  }
+
+  return astar_h(&g, from[dim_x], from[dim_y]);
+}
+
+/* Frees m's landmark tables; for when the map itself goes */
+void path_landmarks_delete(Map *m)
+{
+  int c;
+
+  for (c = 0; c < num_character_types; c++) {
+    free(m->landmarks[c]);
+    m->landmarks[c] = NULL;
+  }
+}
+
+/* The map has changed or been freed; the next pathfind starts over */
+void pathfind_invalidate(void)
+{
+  int f;
+
+  for (f = 0; f < PATHFIND_MAX_FIELDS; f++) {
+    held[f].map = NULL;
+  }
+  wanted = NULL;
+  pending = 0;
+}
+
+/* The types have been regrouped, so no field means what it did */
+static void forget_fields(void)
+{
+  pathfind_invalidate();
+  pathfind_cache_flush();
+}
+
+void pathfind_set_verify(int v)
+{
+  verify = v;
+}
+
+void pathfind_set_cache(int on)
+{
+  cache_enabled = on;
+}
+
+void pathfind_set_speculation(int on)
+{
+  speculation = on;
+}
+
+void pathfind_set_landmarks(int on)
+{
+  landmarks_enabled = on;
+}
+
+void pathfind_set_early_exit(int on)
+{
+  early_exit = on;
+}
+
+/* Zero for no limit.  Pursuers further than r from the PC stand still */
+void pathfind_set_radius(int32_t r)
+{
+  radius = r;
+}
+
+/* Empties the cache; stale entries never need this, but a benchmark *
+ * wants to start cold.                                              */
+void pathfind_cache_flush(void)
+{
+  int i;
+
+  for (i = 0; i < PATHFIND_CACHE_SIZE; i++) {
+    cache[i].used = 0;
+  }
+}
+
+const pathfind_stats_t *pathfind_get_stats(void)
+{
+  return &stats;
+}
+
+void pathfind_set_engine(pathfind_engine_t e)
+{
+  engine = e;
+}
+
+pathfind_engine_t pathfind_get_engine(void)
+{
+  return engine;
+}
+
+int pathfind_find_engine(const char *name)
+{
+  int i;
+
+  for (i = 0; i < num_pathfind_engines; i++) {
+    if (!strcmp(name, pathfind_engine_name[i])) {
+      return i;
+    }
+  }
+
+  return -1;
+}
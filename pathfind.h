@@ -0,0 +1,99 @@
+#ifndef PATHFIND_H
+# define PATHFIND_H
+
+# include "poke327.h"
+
+/* Every engine computes the same distance maps.  Most differ only in *
+ * the priority queue driving Dijkstra's algorithm, and in whether    *
+ * the maps are computed one after the other or (fused) in a single   *
+ * traversal; chamfer sweeps the whole map with SIMD instead of       *
+ * keeping a queue.                                                    */
+typedef enum pathfind_engine {
+  pathfind_fibonacci,
+  pathfind_intrusive,
+  pathfind_dial,
+  pathfind_fused,
+  pathfind_chamfer,
+  num_pathfind_engines
+} pathfind_engine_t;
+
+extern const char *pathfind_engine_name[num_pathfind_engines];
+
+/* pathfind() maintains one distance map, or field, per distinct row  *
+ * of move_cost among the NPC types; types whose rows are identical   *
+ * share a field.  pathfind_dist() finds the one a type's moves are   *
+ * costed by; fields live in world.dist, indexed by pathfind_field().  */
+# define PATHFIND_MAX_FIELDS (num_character_types - 1)
+
+/* Distances are 16 bits, which any real path fits in with room to   *
+ * spare.  PATHFIND_INF is unreachable, not explored, or (though no  *
+ * map comes close) too far to count: the fields saturate.           */
+# define PATHFIND_INF UINT16_MAX
+
+typedef uint16_t pathfind_row_t[MAP_X];
+
+/* pathfind_multi() takes up to this many sources, and marks cells *
+ * none of them reaches PATHFIND_NO_OWNER.                          */
+# define PATHFIND_MAX_SOURCES 64
+# define PATHFIND_NO_OWNER UINT8_MAX
+
+/* How many distance maps pathfind() keeps for reuse; each field's *
+ * map for a position takes an entry.                              */
+# define PATHFIND_CACHE_SIZE 64
+
+/* Counts of distance maps, not of pathfind() calls, but for skipped */
+typedef struct pathfind_stats {
+  uint32_t full;       /* Recomputed from scratch */
+  uint32_t repaired;   /* Repaired after a one-cell PC move */
+  uint32_t cached;     /* Found in the cache */
+  uint32_t bounded;    /* Only explored as far as the pursuers */
+  uint32_t verified;   /* Repairs and cache hits checked against a *
+                        * full recompute                           */
+  uint32_t avoided;    /* Wanted by pathfind() but never needed */
+  uint32_t skipped;    /* pathfind() calls, with nothing new to want */
+  uint32_t speculated; /* Computed ahead while waiting for a key... */
+  uint32_t foreseen;   /* ...and then loaded from the cache */
+  uint32_t queries;    /* path_query() calls... */
+  uint32_t expanded;   /* ...and the cells they settled */
+  uint32_t landmarks;  /* Landmark tables built for path_query() */
+} pathfind_stats_t;
+
+/* A route found by path_query() */
+typedef struct path_route {
+  int32_t cost;                /* INT_MAX if there is none */
+  uint16_t len;                /* Steps, not counting the start */
+  pair_t step[MAP_X * MAP_Y];
+} path_route_t;
+
+void pathfind(Map *m);
+void pathfind_need(character_type_t ctype);
+void pathfind_need_near(character_type_t ctype, const pair_t pos);
+int pathfind_field(character_type_t ctype);
+int pathfind_num_fields(void);
+pathfind_row_t *pathfind_dist(character_type_t ctype);
+uint8_t pathfind_next_hops(character_type_t ctype, const pair_t pos);
+void pathfind_multi(Map *m, character_type_t ctype, const pair_t *sources,
+                    int count, pathfind_row_t *dist, uint8_t (*owner)[MAP_X]);
+void pathfind_with(Map *m, pathfind_engine_t e);
+void pathfind_set_engine(pathfind_engine_t e);
+pathfind_engine_t pathfind_get_engine(void);
+int pathfind_find_engine(const char *name);
+void pathfind_invalidate(void);
+void pathfind_set_verify(int v);
+void pathfind_set_cache(int on);
+void pathfind_set_landmarks(int on);
+void pathfind_set_speculation(int on);
+void pathfind_speculate(Map *m);
+void pathfind_speculate_stop(void);
+void pathfind_speculate_wait(void);
+void pathfind_set_early_exit(int on);
+void pathfind_set_radius(int32_t r);
+void pathfind_cache_flush(void);
+const pathfind_stats_t *pathfind_get_stats(void);
+int32_t path_query(Map *m, const pair_t from, const pair_t to,
+                   character_type_t ctype, path_route_t *route);
+int32_t path_estimate(Map *m, const pair_t from, const pair_t to,
+                      character_type_t ctype);
+void path_landmarks_delete(Map *m);
+
+#endif
@@ -8,12 +8,17 @@
 #include <sys/time.h>
 #include <assert.h>
 #include <unistd.h>
+#include <ctype.h>
 
 #include "heap.h"
 #include "poke327.h"
 #include "character.h"
 #include "io.h"
 #include "db_parse.h"
+#include "encounter.h"
+#include "pokedex.h"
+#include "pathfind.h"
+#include "bench.h"
 
 typedef struct queue_node {
   int x, y;
@@ -22,6 +27,7 @@ typedef struct queue_node {
 
 World world;
 
+/* map_grid::step has the same neighbours in the same order */
 pair_t all_dirs[8] = {
   { -1, -1 },
   { -1,  0 },
@@ -44,34 +50,38 @@ static int32_t edge_penalty(int8_t x, int8_t y)
 
 static void dijkstra_path(Map *m, pair_t from, pair_t to)
 {
-  static path_t path[MAP_Y][MAP_X], *p;
+  static path_t path[map_grid::cells], *p, *n;
   static uint32_t initialized = 0;
-  heap_t h;
-  int32_t x, y;
+  static heap_t h;
+  int32_t x, y, c;
+  int k;
+
+  if (!initialized || h.backend != heap_get_default_backend()) {
+    heap_delete(&h);
+    heap_init(&h, path_cmp, NULL);
+    heap_set_name(&h, "dijkstra_path");
+  }
 
   if (!initialized) {
     for (y = 0; y < MAP_Y; y++) {
       for (x = 0; x < MAP_X; x++) {
-        path[y][x].pos[dim_y] = y;
-        path[y][x].pos[dim_x] = x;
+        path[map_grid::index(x, y)].pos[dim_y] = y;
+        path[map_grid::index(x, y)].pos[dim_x] = x;
       }
     }
     initialized = 1;
   }
   
-  for (y = 0; y < MAP_Y; y++) {
-    for (x = 0; x < MAP_X; x++) {
-      path[y][x].cost = INT_MAX;
-    }
+  for (k = 0; k < map_grid::cells; k++) {
+    path[k].cost = INT_MAX;
   }
 
-  path[from[dim_y]][from[dim_x]].cost = 0;
-
-  heap_init(&h, path_cmp, NULL);
+  path[map_grid::index(from[dim_x], from[dim_y])].cost = 0;
 
   for (y = 1; y < MAP_Y - 1; y++) {
     for (x = 1; x < MAP_X - 1; x++) {
-      path[y][x].hn = heap_insert(&h, &path[y][x]);
+      path[map_grid::index(x, y)].hn =
+        heap_insert(&h, &path[map_grid::index(x, y)]);
     }
   }
 
@@ -81,63 +91,30 @@ static void dijkstra_path(Map *m, pair_t from, pair_t to)
     if ((p->pos[dim_y] == to[dim_y]) && p->pos[dim_x] == to[dim_x]) {
       for (x = to[dim_x], y = to[dim_y];
            (x != from[dim_x]) || (y != from[dim_y]);
-           p = &path[y][x], x = p->from[dim_x], y = p->from[dim_y]) {
+           p = &path[map_grid::index(x, y)],
+             x = p->from[dim_x], y = p->from[dim_y]) {
         mapxy(x, y) = ter_path;
         heightxy(x, y) = 0;
       }
-      heap_delete(&h);
+      heap_clear(&h);
       return;
     }
 
-    if ((path[p->pos[dim_y] - 1][p->pos[dim_x]    ].hn) &&
-        (path[p->pos[dim_y] - 1][p->pos[dim_x]    ].cost >
-         ((p->cost + heightpair(p->pos)) *
-          edge_penalty(p->pos[dim_x], p->pos[dim_y] - 1)))) {
-      path[p->pos[dim_y] - 1][p->pos[dim_x]    ].cost =
-        ((p->cost + heightpair(p->pos)) *
-         edge_penalty(p->pos[dim_x], p->pos[dim_y] - 1));
-      path[p->pos[dim_y] - 1][p->pos[dim_x]    ].from[dim_y] = p->pos[dim_y];
-      path[p->pos[dim_y] - 1][p->pos[dim_x]    ].from[dim_x] = p->pos[dim_x];
-      heap_decrease_key_no_replace(&h, path[p->pos[dim_y] - 1]
-                                           [p->pos[dim_x]    ].hn);
-    }
-    if ((path[p->pos[dim_y]    ][p->pos[dim_x] - 1].hn) &&
-        (path[p->pos[dim_y]    ][p->pos[dim_x] - 1].cost >
-         ((p->cost + heightpair(p->pos)) *
-          edge_penalty(p->pos[dim_x] - 1, p->pos[dim_y])))) {
-      path[p->pos[dim_y]][p->pos[dim_x] - 1].cost =
-        ((p->cost + heightpair(p->pos)) *
-         edge_penalty(p->pos[dim_x] - 1, p->pos[dim_y]));
-      path[p->pos[dim_y]    ][p->pos[dim_x] - 1].from[dim_y] = p->pos[dim_y];
-      path[p->pos[dim_y]    ][p->pos[dim_x] - 1].from[dim_x] = p->pos[dim_x];
-      heap_decrease_key_no_replace(&h, path[p->pos[dim_y]    ]
-                                           [p->pos[dim_x] - 1].hn);
-    }
-    if ((path[p->pos[dim_y]    ][p->pos[dim_x] + 1].hn) &&
-        (path[p->pos[dim_y]    ][p->pos[dim_x] + 1].cost >
-         ((p->cost + heightpair(p->pos)) *
-          edge_penalty(p->pos[dim_x] + 1, p->pos[dim_y])))) {
-      path[p->pos[dim_y]][p->pos[dim_x] + 1].cost =
-        ((p->cost + heightpair(p->pos)) *
-         edge_penalty(p->pos[dim_x] + 1, p->pos[dim_y]));
-      path[p->pos[dim_y]    ][p->pos[dim_x] + 1].from[dim_y] = p->pos[dim_y];
-      path[p->pos[dim_y]    ][p->pos[dim_x] + 1].from[dim_x] = p->pos[dim_x];
-      heap_decrease_key_no_replace(&h, path[p->pos[dim_y]    ]
-                                           [p->pos[dim_x] + 1].hn);
-    }
-    if ((path[p->pos[dim_y] + 1][p->pos[dim_x]    ].hn) &&
-        (path[p->pos[dim_y] + 1][p->pos[dim_x]    ].cost >
-         ((p->cost + heightpair(p->pos)) *
-          edge_penalty(p->pos[dim_x], p->pos[dim_y] + 1)))) {
-      path[p->pos[dim_y] + 1][p->pos[dim_x]    ].cost =
-        ((p->cost + heightpair(p->pos)) *
-         edge_penalty(p->pos[dim_x], p->pos[dim_y] + 1));
-      path[p->pos[dim_y] + 1][p->pos[dim_x]    ].from[dim_y] = p->pos[dim_y];
-      path[p->pos[dim_y] + 1][p->pos[dim_x]    ].from[dim_x] = p->pos[dim_x];
-      heap_decrease_key_no_replace(&h, path[p->pos[dim_y] + 1]
-                                           [p->pos[dim_x]    ].hn);
+    /* Only inner cells are queued, and the border never is, so it *
+     * stops the search without a bounds check.                    */
+    for (k = 0; k < 4; k++) {
+      n = p + map_grid::step4[k];
+      if (n->hn &&
+          (n->cost > (c = ((p->cost + heightpair(p->pos)) *
+                           edge_penalty(n->pos[dim_x], n->pos[dim_y]))))) {
+        n->cost = c;
+        n->from[dim_y] = p->pos[dim_y];
+        n->from[dim_x] = p->pos[dim_x];
+        heap_decrease_key_no_replace(&h, n->hn);
+      }
     }
   }
+  heap_clear(&h);
 }
 
 static int build_paths(Map *m)
@@ -666,6 +643,17 @@ static int place_trees(Map *m)
   return 0;
 }
 
+/* Call after any change to m->map.  Versions are never reused, even *
+ * by a map allocated where a freed one used to be, so anything keyed *
+ * on a map's version goes stale the moment its terrain changes.      */
+void map_terrain_changed(Map *m)
+{
+  static uint32_t version = 0;
+
+  m->terrain_version = ++version;
+  pathfind_invalidate();
+}
+
 void rand_pos(pair_t pos)
 {
   pos[dim_x] = (rand() % (MAP_X - 2)) + 1;
@@ -707,27 +695,34 @@ void generate_num_poke(int &num_poke, Npc *c)
 		  maxl = 100;
 		}
 		int level = rand() % (maxl - minl + 1) + minl;
-		c->poke.push_back(new Pokemon(level));
+		c->poke.push_back(new Pokemon(level,
+		                              encounter_species(world.cur_map->map
+		                                                [c->pos[dim_y]]
+		                                                [c->pos[dim_x]],
+		                                                encounter_distance())));
 	}
 }
 
 void new_hiker()
 {
+  pathfind_row_t *dist;
   pair_t pos;
   Npc *c;
   
+  pathfind_need(char_hiker);
+  dist = pathfind_dist(char_hiker);
   do {
     rand_pos(pos);
-  } while (world.hiker_dist[pos[dim_y]][pos[dim_x]] == INT_MAX ||
+  } while (dist[pos[dim_y]][pos[dim_x]] == PATHFIND_INF ||
            world.cur_map->cmap[pos[dim_y]][pos[dim_x]]         ||
            pos[dim_x] < 3 || pos[dim_x] > MAP_X - 4            ||
            pos[dim_y] < 3 || pos[dim_y] > MAP_Y - 4);
 
   world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c = new Npc;
-  c->num_poke = 1;
-  generate_num_poke(c->num_poke, c);
   c->pos[dim_y] = pos[dim_y];
   c->pos[dim_x] = pos[dim_x];
+  c->num_poke = 1;
+  generate_num_poke(c->num_poke, c);
   c->ctype = char_hiker;
   c->mtype = move_hiker;
   c->dir[dim_x] = 0;
@@ -735,29 +730,31 @@ void new_hiker()
   c->defeated = 0;
   c->symbol = 'h';
   c->next_turn = 0;
-  heap_insert(&world.cur_map->turn, c);
+  turn_insert(&world.cur_map->turn, c);
 
   //  printf("Hiker at %d,%d\n", pos[dim_x], pos[dim_y]);
 }
 
 void new_rival()
 {
+  pathfind_row_t *dist;
   pair_t pos;
   Npc *c;
 
+  pathfind_need(char_rival);
+  dist = pathfind_dist(char_rival);
   do {
     rand_pos(pos);
-  } while (world.rival_dist[pos[dim_y]][pos[dim_x]] == INT_MAX ||
-           world.rival_dist[pos[dim_y]][pos[dim_x]] < 0        ||
+  } while (dist[pos[dim_y]][pos[dim_x]] == PATHFIND_INF ||
            world.cur_map->cmap[pos[dim_y]][pos[dim_x]]         ||
            pos[dim_x] < 3 || pos[dim_x] > MAP_X - 4            ||
            pos[dim_y] < 3 || pos[dim_y] > MAP_Y - 4);
 
   world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c = new Npc;
-  c->num_poke = 1;
-  generate_num_poke(c->num_poke, c);
   c->pos[dim_y] = pos[dim_y];
   c->pos[dim_x] = pos[dim_x];
+  c->num_poke = 1;
+  generate_num_poke(c->num_poke, c);
   c->ctype = char_rival;
   c->mtype = move_rival;
   c->dir[dim_x] = 0;
@@ -765,27 +762,29 @@ void new_rival()
   c->defeated = 0;
   c->symbol = 'r';
   c->next_turn = 0;
-  heap_insert(&world.cur_map->turn, c);
+  turn_insert(&world.cur_map->turn, c);
 }
 
 void new_char_other()
 {
+  pathfind_row_t *dist;
   pair_t pos;
   Npc *c;  
   
+  pathfind_need(char_other);
+  dist = pathfind_dist(char_other);
   do {
     rand_pos(pos);
-  } while (world.rival_dist[pos[dim_y]][pos[dim_x]] == INT_MAX ||
-           world.rival_dist[pos[dim_y]][pos[dim_x]] < 0        ||
+  } while (dist[pos[dim_y]][pos[dim_x]] == PATHFIND_INF ||
            world.cur_map->cmap[pos[dim_y]][pos[dim_x]]         ||
            pos[dim_x] < 3 || pos[dim_x] > MAP_X - 4            ||
            pos[dim_y] < 3 || pos[dim_y] > MAP_Y - 4);
 
   world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c = new Npc;
-  c->num_poke = 1;
-  generate_num_poke(c->num_poke, c);
   c->pos[dim_y] = pos[dim_y];
   c->pos[dim_x] = pos[dim_x];
+  c->num_poke = 1;
+  generate_num_poke(c->num_poke, c);
   c->ctype = char_other;
   switch (rand() % 4) {
   case 0:
@@ -808,7 +807,7 @@ void new_char_other()
   rand_dir(c->dir);
   c->defeated = 0;
   c->next_turn = 0;
-  heap_insert(&world.cur_map->turn, c);
+  turn_insert(&world.cur_map->turn, c);
 }
 
 void place_characters()
@@ -853,7 +852,7 @@ void init_pc()
   world.pc.num_pokeballs = 5;
   world.pc.num_potions = 5;
   world.pc.num_revives = 3;
-  heap_insert(&world.cur_map->turn, &world.pc);
+  turn_insert(&world.cur_map->turn, &world.pc);
 }
 
 void place_pc()
@@ -872,7 +871,7 @@ void place_pc()
 
   world.cur_map->cmap[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = &world.pc;
 
-  if ((c = (Character *) heap_peek_min(&world.cur_map->turn))) {
+  if ((c = turn_peek_min(&world.cur_map->turn))) {
     world.pc.next_turn = c->next_turn;
   } else {
     world.pc.next_turn = 0;
@@ -898,6 +897,7 @@ int new_map(int teleport)
   world.cur_map                                             =
     world.world[world.cur_idx[dim_y]][world.cur_idx[dim_x]] =
     (Map *) malloc(sizeof (*world.cur_map));
+  memset(world.cur_map->landmarks, 0, sizeof (world.cur_map->landmarks));
 
   smooth_height(world.cur_map);
   
@@ -945,6 +945,7 @@ int new_map(int teleport)
   if ((rand() % 100) < p || !d) {
     place_center(world.cur_map);
   }
+  map_terrain_changed(world.cur_map);
 
   for (y = 0; y < MAP_Y; y++) {
     for (x = 0; x < MAP_X; x++) {
@@ -952,7 +953,7 @@ int new_map(int teleport)
     }
   }
 
-  heap_init(&world.cur_map->turn, cmp_char_turns, delete_character);
+  turn_init(&world.cur_map->turn);
 
   if ((world.cur_idx[dim_x] == WORLD_SIZE / 2) &&
       (world.cur_idx[dim_y] == WORLD_SIZE / 2)) {
@@ -963,6 +964,7 @@ int new_map(int teleport)
 
   pathfind(world.cur_map);
   if (teleport) {
+    pathfind_need(char_rival);
     do {
       world.cur_map->cmap[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = NULL;
       world.pc.pos[dim_x] = rand_range(1, MAP_X - 2);
@@ -971,7 +973,8 @@ int new_map(int teleport)
              (move_cost[char_pc][world.cur_map->map[world.pc.pos[dim_y]]
                                                    [world.pc.pos[dim_x]]] ==
               INT_MAX)                                                      ||
-             world.rival_dist[world.pc.pos[dim_y]][world.pc.pos[dim_x]] < 0);
+             pathfind_dist(char_rival)[world.pc.pos[dim_y]]
+                                      [world.pc.pos[dim_x]] == PATHFIND_INF);
     world.cur_map->cmap[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = &world.pc;
     pathfind(world.cur_map);
   }
@@ -1045,13 +1048,14 @@ void delete_world()
 {
   int x, y;
 
-  //Only correct because current game never leaves the initial map
-  //Need to iterate over all maps in 1.05+
-  heap_delete(&world.cur_map->turn);
+  encounter_delete_tables();
+  pathfind_invalidate();
 
   for (y = 0; y < WORLD_SIZE; y++) {
     for (x = 0; x < WORLD_SIZE; x++) {
       if (world.world[y][x]) {
+        turn_delete(&world.world[y][x]->turn);
+        path_landmarks_delete(world.world[y][x]);
         free(world.world[y][x]);
         world.world[y][x] = NULL;
       }
@@ -1061,14 +1065,17 @@ void delete_world()
 
 void print_hiker_dist()
 {
+  pathfind_row_t *dist;
   int x, y;
 
+  pathfind_need(char_hiker);
+  dist = pathfind_dist(char_hiker);
   for (y = 0; y < MAP_Y; y++) {
     for (x = 0; x < MAP_X; x++) {
-      if (world.hiker_dist[y][x] == INT_MAX) {
+      if (dist[y][x] == PATHFIND_INF) {
         printf("   ");
       } else {
-        printf(" %5d", world.hiker_dist[y][x]);
+        printf(" %5d", dist[y][x]);
       }
     }
     printf("\n");
@@ -1077,14 +1084,17 @@ void print_hiker_dist()
 
 void print_rival_dist()
 {
+  pathfind_row_t *dist;
   int x, y;
 
+  pathfind_need(char_rival);
+  dist = pathfind_dist(char_rival);
   for (y = 0; y < MAP_Y; y++) {
     for (x = 0; x < MAP_X; x++) {
-      if (world.rival_dist[y][x] == INT_MAX || world.rival_dist[y][x] < 0) {
+      if (dist[y][x] == PATHFIND_INF) {
         printf("   ");
       } else {
-        printf(" %02d", world.rival_dist[y][x] % 100);
+        printf(" %02d", dist[y][x] % 100);
       }
     }
     printf("\n");
@@ -1113,7 +1123,7 @@ void game_loop()
   pair_t d;
   
   while (!world.quit) {
-    c = (Character *) heap_remove_min(&world.cur_map->turn);
+    c = turn_remove_min(&world.cur_map->turn);
     n = dynamic_cast<Npc *> (c);
     p = dynamic_cast<Pc *> (c);
 
@@ -1128,11 +1138,6 @@ void game_loop()
     }
     world.cur_map->cmap[d[dim_y]][d[dim_x]] = c;
 
-    if (p) {
-      // Performance bug - pathfinding runs twice after generating a new map
-      pathfind(world.cur_map);
-    }
-
     c->next_turn += move_cost[n ? n->ctype : char_pc]
                              [world.cur_map->map[d[dim_y]][d[dim_x]]];
 
@@ -1145,20 +1150,59 @@ void game_loop()
     c->pos[dim_y] = d[dim_y];
     c->pos[dim_x] = d[dim_x];
 
-    heap_insert(&world.cur_map->turn, c);
+    if (p) {
+      // A no-op after leave_map(), whose new_map() already did it
+      pathfind(world.cur_map);
+    }
+
+    turn_insert(&world.cur_map->turn, c);
   }
 }
 
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [--pathfind <engine>] [--heap <backend>] "
+                  "[--verify-pathfind] [--bench] [seed]\n"
+                  "       %s --query '<query>'\n", name, name);
+}
+
 int main(int argc, char *argv[])
 {
   struct timeval tv;
   uint32_t seed;
+  int i, bench, seeded;
   //  char c;
   //  int x, y;
 
-  if (argc == 2) {
-    seed = atoi(argv[1]);
-  } else {
+  bench = seeded = 0;
+  seed = 0;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--query") && i + 1 < argc) {
+      db_parse(false);
+      return dex_query_main(argv[i + 1]);
+    } else if (!strcmp(argv[i], "--bench")) {
+      bench = 1;
+    } else if (!strcmp(argv[i], "--pathfind") && i + 1 < argc &&
+               pathfind_find_engine(argv[i + 1]) >= 0) {
+      pathfind_set_engine((pathfind_engine_t)
+                          pathfind_find_engine(argv[++i]));
+    } else if (!strcmp(argv[i], "--verify-pathfind")) {
+      pathfind_set_verify(1);
+    } else if (!strcmp(argv[i], "--heap") && i + 1 < argc &&
+               heap_find_backend(argv[i + 1]) >= 0) {
+      heap_set_default_backend((heap_backend_t)
+                               heap_find_backend(argv[++i]));
+    } else if (isdigit(argv[i][0])) {
+      seed = atoi(argv[i]);
+      seeded = 1;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!seeded) {
     gettimeofday(&tv, NULL);
     seed = (tv.tv_usec ^ (tv.tv_sec << 20)) & 0xffffffff;
   }
@@ -1167,6 +1211,10 @@ int main(int argc, char *argv[])
   srand(seed);
   
   db_parse(false);
+
+  if (bench) {
+    return bench_main(seed);
+  }
   
   io_init_terminal();
   
@@ -7,8 +7,12 @@
 
 
 # include "heap.h"
+# include "iheap.h"
+# include "turn.h"
 # include "character.h"
 # include "pokemon.h"
+# include "storage.h"
+# include "grid.h"
 
 #define malloc(size) ({          \
   void *_tmp;                    \
@@ -45,6 +49,9 @@ typedef int16_t pair_t[num_dims];
 #define ADD_TRAINER_PROB   50
 #define ENCOUNTER_PROB     10
 
+/* Map::map, height and cmap, and world.dist, flattened */
+typedef grid<MAP_X, MAP_Y> map_grid;
+
 #define mappair(pair) (m->map[pair[dim_y]][pair[dim_x]])
 #define mapxy(x, y) (m->map[y][x])
 #define heightpair(pair) (m->height[pair[dim_y]][pair[dim_x]])
@@ -85,15 +92,19 @@ typedef enum __attribute__ ((__packed__)) character_type {
 } character_type_t;
 
 class Character;
+struct path_landmarks;
 
 class Map {
  public:
   terrain_type_t map[MAP_Y][MAP_X];
   uint8_t height[MAP_Y][MAP_X];
   Character *cmap[MAP_Y][MAP_X];
-  heap_t turn;
+  turn_queue_t turn;
   int32_t num_trainers;
   int8_t n, s, e, w;
+  uint32_t terrain_version; /* Set by map_terrain_changed() */
+  /* path_query()'s landmark tables, one set per profile, made on demand */
+  struct path_landmarks *landmarks[num_character_types];
 };
 
 /* Here instead of character.h to abvoid including character.h */
@@ -102,6 +113,7 @@ class Character {
   pair_t pos;
   char symbol;
   int next_turn;
+  Character *turn_next, *turn_prev; /* Links in the map's turn_queue_t */
   int num_poke;
   std::vector<Pokemon*> poke;
   virtual ~Character() {}
@@ -112,6 +124,7 @@ class Pc : public Character {
  	int num_pokeballs;
  	int num_potions;
  	int num_revives;
+  Storage box;
 };
 
 class Npc : public Character {
@@ -128,9 +141,10 @@ class World {
   pair_t cur_idx;
   Map *cur_map;
   /* Please distance maps in world, not map, since *
-   * we only need one pair at any given time.      */
-  int hiker_dist[MAP_Y][MAP_X];
-  int rival_dist[MAP_Y][MAP_X];
+   * we only need one set at any given time.       *
+   * One per pathfind field; see pathfind_dist().  *
+   * 16 bits a distance, PATHFIND_INF if too far.   */
+  uint16_t dist[num_character_types - 1][MAP_Y][MAP_X];
   Pc pc;
   int quit;
 };
@@ -153,11 +167,18 @@ extern pair_t all_dirs[8];
 
 typedef struct path {
   heap_node_t *hn;
+  iheap_node<struct path> node;
   uint8_t pos[2];
   uint8_t from[2];
   int32_t cost;
 } path_t;
 
 int new_map(int teleport);
+void rand_pos(pair_t pos);
+void map_terrain_changed(Map *m);
+void init_world();
+void new_hiker();
+void new_rival();
+void delete_world();
 
 #endif
@@ -0,0 +1,503 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+#include "pokedex.h"
+#include "pokemon.h"
+#include "db_parse.h"
+
+/**************************************************************************
+ * Pokedex query engine.  Species data is copied once into columns of    *
+ * 16-bit values (one row per species, rows padded to a multiple of the  *
+ * SSE lane count), and each query term is a vectorized scan that ANDs   *
+ * a per-row mask.  Stat terms compare level-scaled stats, computed for  *
+ * the whole column with pokemon_effective_stat(), the same function     *
+ * the Pokemon constructors use.                                         *
+ *                                                                       *
+ * A query is a list of whitespace separated terms:                      *
+ *   level=N iv=N        Scaling for stat terms (default 50 and 0)       *
+ *   type=NAME           Either slot matches; type!=NAME excludes        *
+ *   gen=N legendary=0|1 Generation, legendary or mythical               *
+ *   STAT<op>N           hp atk def spatk spdef speed total with any of  *
+ *                       = != < <= > >=                                  *
+ *   sort=STAT|id        Descending by stat, or ascending species id     *
+ *   order=asc|desc      Override the sort direction                     *
+ *   limit=N             Return at most N rows                           *
+ **************************************************************************/
+
+#define DEX_NUM_SPECIES 898
+#define DEX_LANES       8
+#define DEX_ROWS        (((DEX_NUM_SPECIES + DEX_LANES - 1) / DEX_LANES) * \
+                         DEX_LANES)
+#define DEX_MAX_TERMS   32
+
+typedef enum dex_op {
+  dex_eq,
+  dex_ne,
+  dex_lt,
+  dex_le,
+  dex_gt,
+  dex_ge
+} dex_op_t;
+
+typedef enum dex_column {
+  dex_col_hp,
+  dex_col_atk,
+  dex_col_def,
+  dex_col_spatk,
+  dex_col_spdef,
+  dex_col_speed,
+  dex_col_total,
+  dex_col_type,
+  dex_col_generation,
+  dex_col_legendary,
+  dex_col_id
+} dex_column_t;
+
+typedef struct dex_term {
+  dex_column_t column;
+  dex_op_t op;
+  int16_t value;
+} dex_term_t;
+
+/* Row r holds species r + 1, since species[] is 1-indexed */
+typedef struct dex_columns {
+  int initialized;
+  int16_t base[6][DEX_ROWS];
+  int16_t type1[DEX_ROWS];
+  int16_t type2[DEX_ROWS];
+  int16_t generation[DEX_ROWS];
+  int16_t legendary[DEX_ROWS];
+} dex_columns_t;
+
+static dex_columns_t dex;
+
+static const char *dex_column_name[] = {
+  "hp",
+  "atk",
+  "def",
+  "spatk",
+  "spdef",
+  "speed",
+  "total",
+  "type",
+  "gen",
+  "legendary",
+  "id",
+};
+
+static void dex_init()
+{
+  int r, s, t;
+
+  if (dex.initialized) {
+    return;
+  }
+
+  for (r = 0; r < DEX_NUM_SPECIES; r++) {
+    for (s = 0; s < 6; s++) {
+      dex.base[s][r] = pokemon_stats[(r + 1) * 6 - 5 + s].base_stat;
+    }
+    dex.generation[r] = species[r + 1].generation_id;
+    dex.legendary[r] = (species[r + 1].is_legendary > 0 ||
+                        species[r + 1].is_mythical > 0);
+  }
+
+  for (t = 1; t < (int) (sizeof (pokemon_types) / sizeof (pokemon_types[0]));
+       t++) {
+    r = pokemon_types[t].pokemon_id - 1;
+    if (r >= 0 && r < DEX_NUM_SPECIES) {
+      if (pokemon_types[t].slot == 1) {
+        dex.type1[r] = pokemon_types[t].type_id;
+      } else {
+        dex.type2[r] = pokemon_types[t].type_id;
+      }
+    }
+  }
+
+  dex.initialized = 1;
+}
+
+/* mask[r] &= (col[r] op value), eight rows at a time */
+static void dex_scan(int16_t *mask, const int16_t *col,
+                     dex_op_t op, int16_t value)
+{
+  int r;
+#ifdef __SSE2__
+  __m128i c, x, m, ones;
+
+  c = _mm_set1_epi16(value);
+  ones = _mm_set1_epi16(-1);
+
+# define dex_sse_scan(expr)                                        \
+  for (r = 0; r < DEX_ROWS; r += DEX_LANES) {                      \
+    x = _mm_loadu_si128((const __m128i *) (col + r));              \
+    m = (expr);                                                    \
+    _mm_storeu_si128((__m128i *) (mask + r),                       \
+                     _mm_and_si128(m, _mm_loadu_si128((const __m128i *) \
+                                                      (mask + r)))); \
+  }
+
+  switch (op) {
+  case dex_eq:
+    dex_sse_scan(_mm_cmpeq_epi16(x, c));
+    break;
+  case dex_ne:
+    dex_sse_scan(_mm_xor_si128(_mm_cmpeq_epi16(x, c), ones));
+    break;
+  case dex_lt:
+    dex_sse_scan(_mm_cmplt_epi16(x, c));
+    break;
+  case dex_le:
+    dex_sse_scan(_mm_xor_si128(_mm_cmpgt_epi16(x, c), ones));
+    break;
+  case dex_gt:
+    dex_sse_scan(_mm_cmpgt_epi16(x, c));
+    break;
+  case dex_ge:
+    dex_sse_scan(_mm_xor_si128(_mm_cmplt_epi16(x, c), ones));
+    break;
+  }
+
+# undef dex_sse_scan
+#else
+  for (r = 0; r < DEX_ROWS; r++) {
+    switch (op) {
+    case dex_eq:
+      mask[r] &= -(col[r] == value);
+      break;
+    case dex_ne:
+      mask[r] &= -(col[r] != value);
+      break;
+    case dex_lt:
+      mask[r] &= -(col[r] < value);
+      break;
+    case dex_le:
+      mask[r] &= -(col[r] <= value);
+      break;
+    case dex_gt:
+      mask[r] &= -(col[r] > value);
+      break;
+    case dex_ge:
+      mask[r] &= -(col[r] >= value);
+      break;
+    }
+  }
+#endif
+}
+
+/* Type matches in either slot: mask[r] &= (t1 == v || t2 == v) */
+static void dex_scan_type(int16_t *mask, dex_op_t op, int16_t value)
+{
+  int r;
+#ifdef __SSE2__
+  __m128i c, m;
+
+  c = _mm_set1_epi16(value);
+  for (r = 0; r < DEX_ROWS; r += DEX_LANES) {
+    m = _mm_or_si128(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)
+                                                     (dex.type1 + r)), c),
+                     _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)
+                                                     (dex.type2 + r)), c));
+    if (op == dex_ne) {
+      m = _mm_xor_si128(m, _mm_set1_epi16(-1));
+    }
+    _mm_storeu_si128((__m128i *) (mask + r),
+                     _mm_and_si128(m, _mm_loadu_si128((const __m128i *)
+                                                      (mask + r))));
+  }
+#else
+  for (r = 0; r < DEX_ROWS; r++) {
+    mask[r] &= -((dex.type1[r] == value || dex.type2[r] == value) ==
+                 (op != dex_ne));
+  }
+#endif
+}
+
+static int dex_type_id(const char *name)
+{
+  int i;
+
+  for (i = 1; i < (int) (sizeof (types) / sizeof (types[0])); i++) {
+    if (types[i] && !strcasecmp(types[i], name)) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static int dex_parse_term(char *tok, dex_term_t *t, int *level, int *iv,
+                          int *sort, int *order, int *limit,
+                          char *err, size_t errlen)
+{
+  char *op, *value, *end;
+  unsigned i;
+  long v;
+
+  for (op = tok; *op && !strchr("<>=!", *op); op++)
+    ;
+  if (!*op || op == tok) {
+    snprintf(err, errlen, "Expected <key><op><value>: %s", tok);
+    return -1;
+  }
+
+  value = op;
+  if (value[0] == '!' && value[1] == '=') {
+    t->op = dex_ne;
+    value += 2;
+  } else if (value[0] == '<' && value[1] == '=') {
+    t->op = dex_le;
+    value += 2;
+  } else if (value[0] == '>' && value[1] == '=') {
+    t->op = dex_ge;
+    value += 2;
+  } else if (value[0] == '<') {
+    t->op = dex_lt;
+    value++;
+  } else if (value[0] == '>') {
+    t->op = dex_gt;
+    value++;
+  } else if (value[0] == '=') {
+    t->op = dex_eq;
+    value++;
+  } else {
+    snprintf(err, errlen, "Bad operator: %s", tok);
+    return -1;
+  }
+  *op = '\0';
+
+  if (!strcmp(tok, "type")) {
+    if (t->op != dex_eq && t->op != dex_ne) {
+      snprintf(err, errlen, "type only supports = and !=");
+      return -1;
+    }
+    if ((t->value = dex_type_id(value)) < 0) {
+      snprintf(err, errlen, "Unknown type: %s", value);
+      return -1;
+    }
+    t->column = dex_col_type;
+    return 1;
+  }
+
+  if (!strcmp(tok, "sort")) {
+    for (i = 0; i < sizeof (dex_column_name) / sizeof (dex_column_name[0]);
+         i++) {
+      if (!strcmp(value, dex_column_name[i]) &&
+          (i <= dex_col_total || i == dex_col_id)) {
+        *sort = i;
+        return 0;
+      }
+    }
+    snprintf(err, errlen, "Can't sort by %s", value);
+    return -1;
+  }
+
+  if (!strcmp(tok, "order")) {
+    if (!strcmp(value, "asc")) {
+      *order = 1;
+    } else if (!strcmp(value, "desc")) {
+      *order = 0;
+    } else {
+      snprintf(err, errlen, "order is asc or desc");
+      return -1;
+    }
+    return 0;
+  }
+
+  /* The key first, so that a bad one isn't reported as a bad number */
+  if (!strcmp(tok, "level") || !strcmp(tok, "iv") || !strcmp(tok, "limit")) {
+    if (t->op != dex_eq) {
+      snprintf(err, errlen, "%s only supports =", tok);
+      return -1;
+    }
+  } else {
+    for (i = 0; i < sizeof (dex_column_name) / sizeof (dex_column_name[0]);
+         i++) {
+      if (!strcmp(tok, dex_column_name[i]) && i != dex_col_type) {
+        break;
+      }
+    }
+    if (i == sizeof (dex_column_name) / sizeof (dex_column_name[0])) {
+      snprintf(err, errlen, "Unknown key: %s", tok);
+      return -1;
+    }
+    t->column = (dex_column_t) i;
+  }
+
+  v = strtol(value, &end, 10);
+  if (!*value || *end || v < -32768 || v > 32767) {
+    snprintf(err, errlen, "Bad number: %s", value);
+    return -1;
+  }
+
+  if (!strcmp(tok, "level")) {
+    *level = v;
+  } else if (!strcmp(tok, "iv")) {
+    *iv = v;
+  } else if (!strcmp(tok, "limit")) {
+    *limit = v;
+  } else {
+    t->value = v;
+    return 1;
+  }
+
+  return 0;
+}
+
+int dex_query(const char *query, std::vector<dex_result_t> &out,
+              char *err, size_t errlen)
+{
+  static int16_t scaled[DEX_NUM_STATS][DEX_ROWS];
+  static int16_t id[DEX_ROWS];
+  static int16_t mask[DEX_ROWS];
+  dex_term_t term[DEX_MAX_TERMS];
+  int num_terms, level, iv, sort, order, ascending, limit;
+  int r, s, i;
+  char *q, *tok;
+  dex_result_t res;
+
+  dex_init();
+  out.clear();
+
+  level = 50;
+  iv = 0;
+  sort = dex_col_id;
+  order = -1;
+  limit = 0;
+
+  q = strdup(query);
+  for (num_terms = 0, tok = strtok(q, " \t\n"); tok;
+       tok = strtok(NULL, " \t\n")) {
+    if (num_terms == DEX_MAX_TERMS) {
+      snprintf(err, errlen, "Too many terms");
+      free(q);
+      return 1;
+    }
+    switch (dex_parse_term(tok, term + num_terms, &level, &iv,
+                           &sort, &order, &limit, err, errlen)) {
+    case -1:
+      free(q);
+      return 1;
+    case 1:
+      num_terms++;
+      break;
+    }
+  }
+  free(q);
+
+  /* Stats rank best first, ids count up, unless told otherwise */
+  ascending = order >= 0 ? order : sort == dex_col_id;
+
+  if (level < 1 || level > 100 || iv < 0 || iv > 15) {
+    snprintf(err, errlen, "level is 1-100 and iv is 0-15");
+    return 1;
+  }
+
+  /* Scale every stat column for this level and IV */
+  for (r = 0; r < DEX_NUM_SPECIES; r++) {
+    scaled[DEX_STAT_TOTAL][r] = 0;
+    for (s = 0; s < 6; s++) {
+      scaled[s][r] = pokemon_effective_stat(s, dex.base[s][r], iv, level);
+      scaled[DEX_STAT_TOTAL][r] += scaled[s][r];
+    }
+    id[r] = r + 1;
+    mask[r] = -1;
+  }
+  for (; r < DEX_ROWS; r++) {
+    mask[r] = 0;
+  }
+
+  for (i = 0; i < num_terms; i++) {
+    switch (term[i].column) {
+    case dex_col_type:
+      dex_scan_type(mask, term[i].op, term[i].value);
+      break;
+    case dex_col_generation:
+      dex_scan(mask, dex.generation, term[i].op, term[i].value);
+      break;
+    case dex_col_legendary:
+      dex_scan(mask, dex.legendary, term[i].op, term[i].value);
+      break;
+    case dex_col_id:
+      dex_scan(mask, id, term[i].op, term[i].value);
+      break;
+    default:
+      dex_scan(mask, scaled[term[i].column], term[i].op, term[i].value);
+      break;
+    }
+  }
+
+  for (r = 0; r < DEX_NUM_SPECIES; r++) {
+    if (mask[r]) {
+      res.species = r + 1;
+      for (s = 0; s < DEX_NUM_STATS; s++) {
+        res.stat[s] = scaled[s][r];
+      }
+      out.push_back(res);
+    }
+  }
+
+  if (sort != dex_col_id) {
+    std::stable_sort(out.begin(), out.end(),
+                     [sort, ascending](const dex_result_t &a,
+                                       const dex_result_t &b) {
+                       return (ascending ? a.stat[sort] < b.stat[sort] :
+                                           a.stat[sort] > b.stat[sort]);
+                     });
+  } else if (!ascending) {
+    std::reverse(out.begin(), out.end());
+  }
+
+  if (limit > 0 && out.size() > (size_t) limit) {
+    out.resize(limit);
+  }
+
+  return 0;
+}
+
+const char *dex_format_header(void)
+{
+  return " No. Species      Type1    Type2      HP  ATK  DEF SPATK SPDEF "
+         "SPEED TOTAL";
+}
+
+int dex_format_result(const dex_result_t &r, char *s, size_t len)
+{
+  return snprintf(s, len, "%4d %-12.12s %-8s %-8s %4d %4d %4d %5d %5d %5d %5d",
+                  r.species, species[r.species].identifier,
+                  dex.type1[r.species - 1] ? types[dex.type1[r.species - 1]] :
+                                             "",
+                  dex.type2[r.species - 1] ? types[dex.type2[r.species - 1]] :
+                                             "",
+                  r.stat[stat_hp], r.stat[stat_atk], r.stat[stat_def],
+                  r.stat[stat_spatk], r.stat[stat_spdef], r.stat[stat_speed],
+                  r.stat[DEX_STAT_TOTAL]);
+}
+
+int dex_query_main(const char *query)
+{
+  std::vector<dex_result_t> out;
+  char err[80];
+  char s[100];
+  size_t i;
+
+  if (dex_query(query, out, err, sizeof (err))) {
+    fprintf(stderr, "%s\n", err);
+    return 1;
+  }
+
+  printf("%s\n", dex_format_header());
+  for (i = 0; i < out.size(); i++) {
+    dex_format_result(out[i], s, sizeof (s));
+    printf("%s\n", s);
+  }
+  printf("%lu species\n", (unsigned long) out.size());
+
+  return 0;
+}
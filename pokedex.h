@@ -0,0 +1,23 @@
+#ifndef POKEDEX_H
+# define POKEDEX_H
+
+# include <stdio.h>
+# include <stdint.h>
+# include <vector>
+
+/* hp, atk, def, spatk, spdef and speed are indexed by pokemon_stat */
+# define DEX_STAT_TOTAL 6
+# define DEX_NUM_STATS  7
+
+typedef struct dex_result {
+  int species;
+  int16_t stat[DEX_NUM_STATS];
+} dex_result_t;
+
+int dex_query(const char *query, std::vector<dex_result_t> &out,
+              char *err, size_t errlen);
+int dex_format_result(const dex_result_t &r, char *s, size_t len);
+const char *dex_format_header(void);
+int dex_query_main(const char *query);
+
+#endif
@@ -9,17 +9,24 @@ static int compare_move(const void *v1, const void *v2)
   return ((levelup_move *) v1)->level - ((levelup_move *) v2)->level;
 }
 
-Pokemon::Pokemon(int level) : level(level)
+// Uniform over all species.  Wild Pokemon should come from
+// encounter_species() instead, which knows about habitats and rarity.
+Pokemon::Pokemon(int level) :
+  Pokemon(level, // Subtract 1 because array is 1-indexed
+          (rand() % ((sizeof (species) / sizeof (species[0])) - 1)) + 1)
+{
+}
+
+// Finds the species' level-up moveset and base stats the first time a
+// Pokemon of that species is created, and saves them for next time.
+static pokemon_species_db *species_init(int species_index)
 {
   pokemon_species_db *s;
   unsigned i, j;
   bool found;
 
-  // Subtract 1 because array is 1-indexed
-  pokemon_species_index = rand() % ((sizeof (species) /
-                                     sizeof (species[0])) - 1);
-  s = species + pokemon_species_index;
-  
+  s = species + species_index;
+
   if (!s->levelup_moves) {
     // We have never generated a pokemon of this species before, so we
     // need to find it's level-up moveset and save it for next time.
@@ -53,14 +60,34 @@ Pokemon::Pokemon(int level) : level(level)
           sizeof (*s->levelup_moves), compare_move);
 
     // Also initialize base stats while we're here
-    s->base_stat[0] = pokemon_stats[pokemon_species_index * 6 - 5].base_stat;
-    s->base_stat[1] = pokemon_stats[pokemon_species_index * 6 - 4].base_stat;
-    s->base_stat[2] = pokemon_stats[pokemon_species_index * 6 - 3].base_stat;
-    s->base_stat[3] = pokemon_stats[pokemon_species_index * 6 - 2].base_stat;
-    s->base_stat[4] = pokemon_stats[pokemon_species_index * 6 - 1].base_stat;
-    s->base_stat[5] = pokemon_stats[pokemon_species_index * 6 - 0].base_stat;
+    s->base_stat[0] = pokemon_stats[species_index * 6 - 5].base_stat;
+    s->base_stat[1] = pokemon_stats[species_index * 6 - 4].base_stat;
+    s->base_stat[2] = pokemon_stats[species_index * 6 - 3].base_stat;
+    s->base_stat[3] = pokemon_stats[species_index * 6 - 2].base_stat;
+    s->base_stat[4] = pokemon_stats[species_index * 6 - 1].base_stat;
+    s->base_stat[5] = pokemon_stats[species_index * 6 - 0].base_stat;
   }
 
+  return s;
+}
+
+static void species_types(int species_index, std::vector<int> &type)
+{
+	for(int i = 1; i < 1677; i++)
+	{
+		if(pokemon_types[i].pokemon_id == species[species_index].id)
+			type.push_back(pokemon_types[i].type_id);
+	}
+}
+
+Pokemon::Pokemon(int level, int species_index) :
+  level(level), pokemon_species_index(species_index)
+{
+  pokemon_species_db *s;
+  unsigned i, j;
+
+  s = species_init(pokemon_species_index);
+
   // Get pokemon's move(s).
   for (i = 0;
        i < s->num_levelup_moves && s->levelup_moves[i].level <= level;
@@ -83,10 +110,8 @@ Pokemon::Pokemon(int level) : level(level)
   // Calculate IVs
   for (i = 0; i < 6; i++) {
     IV[i] = rand() & 0xf;
-    effective_stat[i] = 5 + ((s->base_stat[i] + IV[i]) * 2 * level) / 100;
-    if (i == 0) { // HP
-      effective_stat[i] += 5 + level;
-    }
+    effective_stat[i] = pokemon_effective_stat(i, s->base_stat[i],
+                                               IV[i], level);
   }
 
   shiny = ((rand() & 0x1fff) ? false : true);
@@ -94,12 +119,57 @@ Pokemon::Pokemon(int level) : level(level)
   
   max_hp = effective_stat[stat_hp];
   
+  species_types(pokemon_species_index, type);
+}
 
-	for(int i = 1; i < 1677; i++)
-	{
-		if(pokemon_types[i].pokemon_id == s->id)
-			type.push_back(pokemon_types[i].type_id);
-	}
+Pokemon::Pokemon(const pokemon_compact &c) :
+  level(c.level), pokemon_species_index(c.species)
+{
+  pokemon_species_db *s;
+  unsigned i;
+
+  s = species_init(pokemon_species_index);
+
+  for (i = 0; i < 4; i++) {
+    move_index[i] = c.move[i];
+  }
+
+  for (i = 0; i < 6; i++) {
+    IV[i] = (c.iv[i / 2] >> ((i & 1) * 4)) & 0xf;
+    effective_stat[i] = pokemon_effective_stat(i, s->base_stat[i],
+                                               IV[i], level);
+  }
+
+  shiny = c.flags & POKEMON_COMPACT_SHINY;
+  gender = (c.flags & POKEMON_COMPACT_MALE) ? gender_male : gender_female;
+
+  max_hp = effective_stat[stat_hp];
+  effective_stat[stat_hp] = c.hp;
+
+  species_types(pokemon_species_index, type);
+}
+
+void Pokemon::pack(pokemon_compact &c) const
+{
+  unsigned i;
+
+  c.species = pokemon_species_index;
+  c.hp = effective_stat[stat_hp];
+  for (i = 0; i < 4; i++) {
+    c.move[i] = move_index[i];
+  }
+  c.level = level;
+  c.flags = ((shiny ? POKEMON_COMPACT_SHINY : 0) |
+             (gender == gender_male ? POKEMON_COMPACT_MALE : 0));
+  c.iv[0] = c.iv[1] = c.iv[2] = 0;
+  for (i = 0; i < 6; i++) {
+    c.iv[i / 2] |= IV[i] << ((i & 1) * 4);
+  }
+}
+
+int Pokemon::get_species_index() const
+{
+  return pokemon_species_index;
 }
 
 const char *Pokemon::get_species() const
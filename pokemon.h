@@ -3,6 +3,7 @@
 
 # include <iostream>
 # include <vector>
+# include <stdint.h>
 
 enum pokemon_stat {
   stat_hp,
@@ -13,11 +14,33 @@ enum pokemon_stat {
   stat_speed
 };
 
+/* Level-scaled stat as computed when a Pokemon is created.  Also used *
+ * by the Pokedex query engine, so the two always agree.              */
+static inline int pokemon_effective_stat(int stat, int base, int iv, int level)
+{
+  return (5 + ((base + iv) * 2 * level) / 100 +
+          (stat == stat_hp ? 5 + level : 0));
+}
+
 enum pokemon_gender {
   gender_female,
   gender_male
 };
 
+# define POKEMON_COMPACT_SHINY 0x01
+# define POKEMON_COMPACT_MALE  0x02
+
+/* Packed form used by the PC storage box.  Anything not stored here *
+ * (effective stats, max HP, types) is rederived from the species.   */
+struct pokemon_compact {
+  uint16_t species;
+  uint16_t hp;
+  uint16_t move[4];
+  uint8_t level;
+  uint8_t flags;
+  uint8_t iv[3]; /* Two 4-bit IVs per byte */
+};
+
 class Pokemon {
  private:
   int level;
@@ -31,6 +54,10 @@ class Pokemon {
   int max_hp;
  public:
   Pokemon(int level);
+  Pokemon(int level, int species_index);
+  Pokemon(const pokemon_compact &c);
+  void pack(pokemon_compact &c) const;
+  int get_species_index() const;
   const char *get_species() const;
   int get_move_power(int i) const;
   int get_level() const;
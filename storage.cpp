@@ -0,0 +1,236 @@
+#include <stdint.h>
+#include <algorithm>
+
+#include "storage.h"
+#include "db_parse.h"
+
+#define NOT_INDEXED UINT32_MAX
+
+static int storage_level(const pokemon_compact &c)
+{
+  if (c.level < 1) {
+    return 1;
+  }
+  if (c.level > STORAGE_MAX_LEVEL) {
+    return STORAGE_MAX_LEVEL;
+  }
+
+  return c.level;
+}
+
+/* Order doesn't matter within an index list, so removal swaps the last *
+ * entry into the hole and fixes up that entry's recorded position.     */
+static void index_list_remove(std::vector<uint32_t> &list,
+                              std::vector<uint32_t> &pos, uint32_t slot)
+{
+  uint32_t i, last;
+
+  i = pos[slot];
+  last = list.back();
+  list[i] = last;
+  pos[last] = i;
+  list.pop_back();
+  pos[slot] = NOT_INDEXED;
+}
+
+Storage::Storage() : by_species(sizeof (species) / sizeof (species[0]))
+{
+}
+
+uint32_t Storage::size() const
+{
+  return box.size();
+}
+
+const pokemon_compact &Storage::at(uint32_t slot) const
+{
+  return box[slot];
+}
+
+uint32_t Storage::count_species(int s) const
+{
+  return (s > 0 && (uint32_t) s < by_species.size()) ? by_species[s].size() : 0;
+}
+
+uint32_t Storage::count_level(int level) const
+{
+  return (level > 0 && level <= STORAGE_MAX_LEVEL) ? by_level[level].size() : 0;
+}
+
+uint32_t Storage::count_shiny() const
+{
+  return shiny.size();
+}
+
+uint32_t Storage::deposit(const Pokemon *p)
+{
+  pokemon_compact c;
+  uint32_t slot;
+
+  p->pack(c);
+  slot = box.size();
+  box.push_back(c);
+
+  species_pos.push_back(by_species[c.species].size());
+  by_species[c.species].push_back(slot);
+
+  level_pos.push_back(by_level[storage_level(c)].size());
+  by_level[storage_level(c)].push_back(slot);
+
+  if (c.flags & POKEMON_COMPACT_SHINY) {
+    shiny_pos.push_back(shiny.size());
+    shiny.push_back(slot);
+  } else {
+    shiny_pos.push_back(NOT_INDEXED);
+  }
+
+  return slot;
+}
+
+void Storage::index_remove(uint32_t slot)
+{
+  index_list_remove(by_species[box[slot].species], species_pos, slot);
+  index_list_remove(by_level[storage_level(box[slot])], level_pos, slot);
+  if (shiny_pos[slot] != NOT_INDEXED) {
+    index_list_remove(shiny, shiny_pos, slot);
+  }
+}
+
+/* Slot from is about to be copied to slot to; point its index entries *
+ * at the new slot.                                                    */
+void Storage::index_move(uint32_t from, uint32_t to)
+{
+  by_species[box[from].species][species_pos[from]] = to;
+  species_pos[to] = species_pos[from];
+
+  by_level[storage_level(box[from])][level_pos[from]] = to;
+  level_pos[to] = level_pos[from];
+
+  if ((shiny_pos[to] = shiny_pos[from]) != NOT_INDEXED) {
+    shiny[shiny_pos[from]] = to;
+  }
+}
+
+Pokemon *Storage::withdraw(uint32_t slot)
+{
+  Pokemon *p;
+  uint32_t last;
+
+  if (slot >= box.size()) {
+    return NULL;
+  }
+
+  p = new Pokemon(box[slot]);
+
+  index_remove(slot);
+  last = box.size() - 1;
+  if (slot != last) {
+    index_move(last, slot);
+    box[slot] = box[last];
+  }
+  box.pop_back();
+  species_pos.pop_back();
+  level_pos.pop_back();
+  shiny_pos.pop_back();
+
+  return p;
+}
+
+void Storage::query(const storage_filter_t &f, storage_sort_t sort,
+                    std::vector<uint32_t> &out) const
+{
+  const std::vector<uint32_t> *driver;
+  std::vector<uint32_t> count, sorted;
+  uint32_t i, n, min_level, max_level, key;
+  int l;
+
+  out.clear();
+
+  min_level = f.min_level > 0 ? f.min_level : 1;
+  max_level = (f.max_level > 0 && f.max_level < STORAGE_MAX_LEVEL) ?
+              f.max_level : STORAGE_MAX_LEVEL;
+
+  if (f.species < 0 || (uint32_t) f.species >= by_species.size()) {
+    return;
+  }
+
+  /* Start from the smallest list that every match must be in */
+  driver = NULL;
+  if (f.shiny) {
+    driver = &shiny;
+  }
+  if (f.species && (!driver || by_species[f.species].size() < driver->size())) {
+    driver = &by_species[f.species];
+  }
+
+  for (n = 0, i = min_level; i <= max_level; i++) {
+    n += by_level[i].size();
+  }
+
+#define storage_match(slot)                                              \
+  ((!f.species || box[slot].species == f.species)                     && \
+   (!f.shiny || (box[slot].flags & POKEMON_COMPACT_SHINY))            && \
+   (uint32_t) storage_level(box[slot]) >= min_level                   && \
+   (uint32_t) storage_level(box[slot]) <= max_level)
+
+  if (driver && driver->size() <= n) {
+    for (i = 0; i < driver->size(); i++) {
+      if (storage_match((*driver)[i])) {
+        out.push_back((*driver)[i]);
+      }
+    }
+  } else if (n == box.size()) {
+    /* No narrowing index; a straight scan comes out in slot order */
+    for (i = 0; i < box.size(); i++) {
+      if (storage_match(i)) {
+        out.push_back(i);
+      }
+    }
+    if (sort == storage_sort_slot) {
+      return;
+    }
+  } else {
+    /* Level buckets, walked from the top, are already level sorted */
+    for (l = max_level; l >= (int) min_level; l--) {
+      for (i = 0; i < by_level[l].size(); i++) {
+        if (storage_match(by_level[l][i])) {
+          out.push_back(by_level[l][i]);
+        }
+      }
+    }
+    if (sort == storage_sort_level) {
+      return;
+    }
+  }
+
+#undef storage_match
+
+  switch (sort) {
+  case storage_sort_slot:
+    std::sort(out.begin(), out.end());
+    return;
+  case storage_sort_species:
+  case storage_sort_level:
+    /* Counting sort: species ascending, or level descending */
+    count.assign((sort == storage_sort_species ?
+                  by_species.size() : STORAGE_MAX_LEVEL + 1) + 1, 0);
+    for (i = 0; i < out.size(); i++) {
+      key = (sort == storage_sort_species ? box[out[i]].species :
+             STORAGE_MAX_LEVEL - storage_level(box[out[i]]));
+      count[key + 1]++;
+    }
+    for (i = 1; i < count.size(); i++) {
+      count[i] += count[i - 1];
+    }
+    sorted.resize(out.size());
+    for (i = 0; i < out.size(); i++) {
+      key = (sort == storage_sort_species ? box[out[i]].species :
+             STORAGE_MAX_LEVEL - storage_level(box[out[i]]));
+      sorted[count[key]++] = out[i];
+    }
+    out.swap(sorted);
+    return;
+  default:
+    return;
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef STORAGE_H
+# define STORAGE_H
+
+# include <stdint.h>
+# include <vector>
+
+# include "pokemon.h"
+
+# define STORAGE_MAX_LEVEL 100
+
+typedef enum storage_sort {
+  storage_sort_slot,
+  storage_sort_species,
+  storage_sort_level,
+  num_storage_sorts
+} storage_sort_t;
+
+/* Zero means "don't care" for every field */
+typedef struct storage_filter {
+  int species;
+  int min_level;
+  int max_level;
+  int shiny;
+} storage_filter_t;
+
+/* The PC's storage box.  Pokemon are kept packed, and every slot is   *
+ * indexed by species, by level and (if shiny) in a shiny list.  Query *
+ * starts from the smallest index that applies to the filter, and      *
+ * sorting by species or level is a counting sort, so only an          *
+ * unfiltered listing walks the whole box.  Slots are dense;           *
+ * withdrawing moves the last slot into the hole.                      */
+class Storage {
+ private:
+  std::vector<pokemon_compact> box;
+  std::vector<std::vector<uint32_t> > by_species;
+  std::vector<uint32_t> by_level[STORAGE_MAX_LEVEL + 1];
+  std::vector<uint32_t> shiny;
+  /* Where each slot sits in its species, level and shiny lists */
+  std::vector<uint32_t> species_pos, level_pos, shiny_pos;
+  void index_remove(uint32_t slot);
+  void index_move(uint32_t from, uint32_t to);
+ public:
+  Storage();
+  uint32_t size() const;
+  uint32_t deposit(const Pokemon *p);
+  Pokemon *withdraw(uint32_t slot);
+  const pokemon_compact &at(uint32_t slot) const;
+  uint32_t count_species(int species) const;
+  uint32_t count_level(int level) const;
+  uint32_t count_shiny() const;
+  void query(const storage_filter_t &f, storage_sort_t sort,
+             std::vector<uint32_t> &out) const;
+};
+
+#endif
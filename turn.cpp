@@ -0,0 +1,210 @@
+#include <string.h>
+
+#include "turn.h"
+#include "character.h"
+#include "poke327.h"
+
+#define TURN_SLOT(t) ((t) & (TURN_WHEEL_SLOTS - 1))
+
+static void list_append(Character **head, Character **tail, Character *c)
+{
+  c->turn_next = NULL;
+  c->turn_prev = *tail;
+  if (*tail) {
+    (*tail)->turn_next = c;
+  } else {
+    *head = c;
+  }
+  *tail = c;
+}
+
+static void list_unlink(Character **head, Character **tail, Character *c)
+{
+  if (c->turn_prev) {
+    c->turn_prev->turn_next = c->turn_next;
+  } else {
+    *head = c->turn_next;
+  }
+  if (c->turn_next) {
+    c->turn_next->turn_prev = c->turn_prev;
+  } else {
+    *tail = c->turn_prev;
+  }
+  c->turn_next = c->turn_prev = NULL;
+}
+
+static void slot_append(turn_queue_t *q, Character *c)
+{
+  int s = TURN_SLOT(c->next_turn);
+
+  list_append(q->head + s, q->tail + s, c);
+  q->occupied |= 1ULL << s;
+}
+
+static void slot_unlink(turn_queue_t *q, Character *c)
+{
+  int s = TURN_SLOT(c->next_turn);
+
+  list_unlink(q->head + s, q->tail + s, c);
+  if (!q->head[s]) {
+    q->occupied &= ~(1ULL << s);
+  }
+}
+
+/* Everything in the wheel is due in [now, now + TURN_WHEEL_SLOTS) */
+static int in_wheel(turn_queue_t *q, Character *c)
+{
+  return c->next_turn - q->now < TURN_WHEEL_SLOTS;
+}
+
+static void overflow_append(turn_queue_t *q, Character *c)
+{
+  if (!q->overflow_head || c->next_turn < q->overflow_min) {
+    q->overflow_min = c->next_turn;
+  }
+  list_append(&q->overflow_head, &q->overflow_tail, c);
+}
+
+/* Pull in whatever time has caught up with, in scheduling order */
+static void overflow_migrate(turn_queue_t *q)
+{
+  Character *c, *next;
+
+  for (c = q->overflow_head; c; c = next) {
+    next = c->turn_next;
+    if (in_wheel(q, c)) {
+      list_unlink(&q->overflow_head, &q->overflow_tail, c);
+      slot_append(q, c);
+    }
+  }
+  for (c = q->overflow_head; c; c = c->turn_next) {
+    if (c == q->overflow_head || c->next_turn < q->overflow_min) {
+      q->overflow_min = c->next_turn;
+    }
+  }
+}
+
+/* The slot holding the earliest character in the wheel */
+static int next_slot(turn_queue_t *q)
+{
+  int r = TURN_SLOT(q->now);
+  uint64_t rotated;
+
+  rotated = r ? (q->occupied >> r) | (q->occupied << (64 - r)) : q->occupied;
+
+  return TURN_SLOT(r + __builtin_ctzll(rotated));
+}
+
+/* Something was scheduled before now.  Doesn't happen in play, but the *
+ * heap it replaced allowed it, so start the wheel over from t.         */
+static void rebase(turn_queue_t *q, int t)
+{
+  Character *head, *tail, *c;
+  int s;
+
+  head = tail = NULL;
+  while (q->occupied) {
+    s = next_slot(q);
+    while ((c = q->head[s])) {
+      slot_unlink(q, c);
+      list_append(&head, &tail, c);
+    }
+  }
+  while ((c = q->overflow_head)) {
+    list_unlink(&q->overflow_head, &q->overflow_tail, c);
+    list_append(&head, &tail, c);
+  }
+
+  q->now = t;
+  while ((c = head)) {
+    list_unlink(&head, &tail, c);
+    if (in_wheel(q, c)) {
+      slot_append(q, c);
+    } else {
+      overflow_append(q, c);
+    }
+  }
+}
+
+void turn_init(turn_queue_t *q)
+{
+  memset(q, 0, sizeof (*q));
+}
+
+void turn_delete(turn_queue_t *q)
+{
+  Character *c;
+  int s;
+
+  for (s = 0; s < TURN_WHEEL_SLOTS; s++) {
+    while ((c = q->head[s])) {
+      list_unlink(q->head + s, q->tail + s, c);
+      delete_character(c);
+    }
+  }
+  while ((c = q->overflow_head)) {
+    list_unlink(&q->overflow_head, &q->overflow_tail, c);
+    delete_character(c);
+  }
+
+  turn_init(q);
+}
+
+void turn_insert(turn_queue_t *q, Character *c)
+{
+  if (!q->size) {
+    q->now = c->next_turn;
+  } else if (c->next_turn < q->now) {
+    rebase(q, c->next_turn);
+  }
+
+  if (in_wheel(q, c)) {
+    slot_append(q, c);
+  } else {
+    overflow_append(q, c);
+  }
+  q->size++;
+}
+
+void turn_remove(turn_queue_t *q, Character *c)
+{
+  if (in_wheel(q, c)) {
+    slot_unlink(q, c);
+  } else {
+    list_unlink(&q->overflow_head, &q->overflow_tail, c);
+  }
+  q->size--;
+}
+
+Character *turn_peek_min(turn_queue_t *q)
+{
+  if (!q->size) {
+    return NULL;
+  }
+
+  if (!q->occupied) {
+    /* Nothing due until the earliest overflow; skip ahead to it */
+    q->now = q->overflow_min;
+    overflow_migrate(q);
+  }
+
+  return q->head[next_slot(q)];
+}
+
+Character *turn_remove_min(turn_queue_t *q)
+{
+  Character *c;
+
+  if (!(c = turn_peek_min(q))) {
+    return NULL;
+  }
+
+  slot_unlink(q, c);
+  q->size--;
+  q->now = c->next_turn;
+  if (q->overflow_head && q->overflow_min - q->now < TURN_WHEEL_SLOTS) {
+    overflow_migrate(q);
+  }
+
+  return c;
+}
@@ -0,0 +1,39 @@
+#ifndef TURN_H
+# define TURN_H
+
+# include <stdint.h>
+
+class Character;
+
+/* Greater than any finite move cost, so in play every character is *
+ * rescheduled within the wheel.  One bit per slot in occupied.      */
+# define TURN_WHEEL_SLOTS 64
+
+/* The per-map turn scheduler: a timing wheel of FIFO lists threaded  *
+ * through the characters themselves.  A character's slot is          *
+ * next_turn modulo the wheel size, and a bitmap of occupied slots    *
+ * finds the next one in a couple of instructions, so scheduling and  *
+ * popping are O(1) however many NPCs there are.  Characters due      *
+ * further out than the wheel reaches wait in an overflow list and    *
+ * are pulled in as time catches up with them.  Pops come out in      *
+ * next_turn order; ties scheduled within the wheel's reach come out  *
+ * first in first out.  Don't change a queued character's next_turn.  */
+typedef struct turn_queue {
+  Character *head[TURN_WHEEL_SLOTS];
+  Character *tail[TURN_WHEEL_SLOTS];
+  uint64_t occupied;
+  Character *overflow_head;
+  Character *overflow_tail;
+  int overflow_min;
+  int now;
+  uint32_t size;
+} turn_queue_t;
+
+void turn_init(turn_queue_t *q);
+void turn_delete(turn_queue_t *q);
+void turn_insert(turn_queue_t *q, Character *c);
+void turn_remove(turn_queue_t *q, Character *c);
+Character *turn_peek_min(turn_queue_t *q);
+Character *turn_remove_min(turn_queue_t *q);
+
+#endif